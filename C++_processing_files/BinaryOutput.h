@@ -0,0 +1,166 @@
+#ifndef BINARY_OUTPUT
+#define BINARY_OUTPUT
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+
+#include "Hist2D.h"
+#include "Instrumentation.h"
+
+// Binary container for one group's results, read back in R by R_plotting_files/read_hist_binary.R.
+// Everything is little-endian regardless of the host, and laid out as
+//   char[4]  magic "H2DB"
+//   uint32   format version (BINARY_FORMAT_VERSION)
+//   uint32   xbins, ybins
+//   double   x edges [xbins + 1], y edges [ybins + 1]
+//   double   counts [ybins * xbins], row by row with y as the row, the same order Hist2D::print uses
+//   uint64   number of traits rows
+//   uint32   number of traits columns
+//   double   traits, one column after another (all values of column 0, then column 1, ...)
+// Counts are stored as doubles whatever the count type of the histogram, which is exact up to 2^53
+// and is what R's readBin reads natively. The columns of the traits are those of NumericVector::getAllData.
+// A file is assembled in memory and written with a single call.
+//
+// Distance matrices between groups (see HistDistance.h) use a second container:
+//   char[4]  magic "H2DM"
+//   uint32   format version (BINARY_FORMAT_VERSION)
+//   uint32   n, the number of groups
+//   n times  uint32 length followed by that many bytes of group name
+//   double   distances [n * n], row by row
+//
+// Smoothed, normalized density grids (see HistDensity.h) use a third:
+//   char[4]  magic "H2DD"
+//   uint32   format version (BINARY_FORMAT_VERSION)
+//   uint32   xbins, ybins
+//   double   x edges [xbins + 1], y edges [ybins + 1]
+//   double   total of the raw counts
+//   float    densities [ybins * xbins], row by row with y as the row
+
+const std::uint32_t BINARY_FORMAT_VERSION = 1;
+
+class BinaryBuffer
+{
+ public:
+  void putBytes(const char* data, std::size_t size) { m_bytes.insert(m_bytes.end(), data, data + size); }
+
+  void putU32(std::uint32_t value) { putLittleEndian(value, 4); }
+  void putU64(std::uint64_t value) { putLittleEndian(value, 8); }
+
+  void putDouble(double value) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    putLittleEndian(bits, 8);
+  }
+
+  void putFloat(float value) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    putLittleEndian(bits, 4);
+  }
+
+  void putDoubles(const std::vector<double>& values) {
+    for ( double value: values ) putDouble(value);
+  }
+
+  const std::vector<char>& bytes() const { return m_bytes; }
+  void reserve(std::size_t size) { m_bytes.reserve(size); }
+
+  // Writes the whole buffer to filename. Returns false if the file could not be written.
+  bool writeFile(const std::string& filename) const {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    file.write(m_bytes.data(), m_bytes.size());
+    INSTRUMENT_COUNT(BytesWritten, m_bytes.size());
+    return (bool) file;
+  }
+
+ private:
+  std::vector<char> m_bytes;
+
+  void putLittleEndian(std::uint64_t value, int size) {
+    for ( int i = 0; i < size; i++ ) {
+      m_bytes.push_back((char) ((value >> (8 * i)) & 0xff));
+    }
+  }
+};
+
+// Appends the header, edges and counts of hist
+template <typename T, typename CountT>
+void appendHistogram(BinaryBuffer& buffer, const Hist2D<T, CountT>& hist)
+{
+  int xBins = hist.getXBins();
+  int yBins = hist.getYBins();
+  buffer.reserve(buffer.bytes().size() + 16 + 8 * (xBins + yBins + 2 + (std::size_t) xBins * yBins));
+  buffer.putBytes("H2DB", 4);
+  buffer.putU32(BINARY_FORMAT_VERSION);
+  buffer.putU32(xBins);
+  buffer.putU32(yBins);
+  buffer.putDoubles(hist.getXEdges());
+  buffer.putDoubles(hist.getYEdges());
+  for ( int y = 0; y < yBins; y++ ) {
+    for ( int x = 0; x < xBins; x++ ) {
+      buffer.putDouble((double) hist.getCount(y, x));
+    }
+  }
+}
+
+// Appends traits rows (each of the same length) as column blocks
+inline void appendTraits(BinaryBuffer& buffer, const std::vector<std::vector<double>>& rows)
+{
+  std::uint32_t columns = rows.empty() ? 0 : rows.front().size();
+  buffer.reserve(buffer.bytes().size() + 12 + 8 * rows.size() * columns);
+  buffer.putU64(rows.size());
+  buffer.putU32(columns);
+  for ( std::uint32_t column = 0; column < columns; column++ ) {
+    for ( const auto& row: rows ) {
+      buffer.putDouble(row[column]);
+    }
+  }
+}
+
+// Writes a complete container for one group
+template <typename T, typename CountT>
+bool writeBinary(const std::string& filename, const Hist2D<T, CountT>& hist, const std::vector<std::vector<double>>& traits)
+{
+  BinaryBuffer buffer;
+  appendHistogram(buffer, hist);
+  appendTraits(buffer, traits);
+  return buffer.writeFile(filename);
+}
+
+// Writes an n x n matrix of distances between named groups, stored row by row
+inline bool writeDistanceMatrix(const std::string& filename, const std::vector<std::string>& names, const std::vector<double>& values)
+{
+  BinaryBuffer buffer;
+  buffer.reserve(12 + 8 * values.size() + 16 * names.size());
+  buffer.putBytes("H2DM", 4);
+  buffer.putU32(BINARY_FORMAT_VERSION);
+  buffer.putU32(names.size());
+  for ( const auto& name: names ) {
+    buffer.putU32(name.size());
+    buffer.putBytes(name.data(), name.size());
+  }
+  buffer.putDoubles(values);
+  return buffer.writeFile(filename);
+}
+
+// Writes a density grid (a DensityGrid of HistDensity.h)
+template <typename Grid>
+bool writeDensity(const std::string& filename, const Grid& grid)
+{
+  BinaryBuffer buffer;
+  buffer.reserve(24 + 8 * (grid.xEdges.size() + grid.yEdges.size()) + 4 * grid.values.size());
+  buffer.putBytes("H2DD", 4);
+  buffer.putU32(BINARY_FORMAT_VERSION);
+  buffer.putU32(grid.xBins);
+  buffer.putU32(grid.yBins);
+  buffer.putDoubles(grid.xEdges);
+  buffer.putDoubles(grid.yEdges);
+  buffer.putDouble(grid.total);
+  for ( float value: grid.values ) buffer.putFloat(value);
+  return buffer.writeFile(filename);
+}
+
+#endif // BINARY_OUTPUT
@@ -0,0 +1,122 @@
+#ifndef BOUNDED_QUEUE
+#define BOUNDED_QUEUE
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <condition_variable>
+
+// BoundedQueue is a fixed-capacity, lock-free queue connecting exactly one producer thread to exactly
+// one consumer thread. push() waits while the queue is full, so a slow consumer holds back its producer
+// and the amount of data in flight never exceeds the capacity. The producer calls close() once it is
+// done; pop() then drains whatever is left and returns false.
+// A waiting push() or pop() spins for a few yields, which is usually enough for the other side to catch up,
+// then sleeps on a condition variable, so a stalled stage does not keep a core busy. The mutex is only
+// taken by a side that is about to sleep, or to wake one that is asleep.
+template <typename T>
+class BoundedQueue
+{
+ public:
+  explicit BoundedQueue(std::size_t capacity)
+    : m_head(0), m_tail(0), m_closed(false), m_sleepers(0)
+  {
+    std::size_t size = 1;
+    while ( size < capacity ) size <<= 1;
+    m_slots.resize(size);
+    m_mask = size - 1;
+  }
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  // Producer side. Returns false without blocking if the queue is full.
+  bool tryPush(T& item) {
+    if ( !pushOne(item) ) return false;
+    wake();
+    return true;
+  }
+
+  void push(T item) {
+    waitUntil([&] { return pushOne(item); });
+    wake();
+  }
+
+  void close() {
+    m_closed.store(true, std::memory_order_release);
+    wake();
+  }
+
+  // Consumer side. Returns false without blocking if the queue is empty.
+  bool tryPop(T& item) {
+    if ( !popOne(item) ) return false;
+    wake();
+    return true;
+  }
+
+  // Waits for the next item. Returns false once the queue is closed and empty.
+  bool pop(T& item) {
+    bool popped = false;
+    waitUntil([&] { popped = popOne(item); return popped || m_closed.load(std::memory_order_acquire); });
+    if ( !popped ) popped = popOne(item);
+    if ( popped ) wake();
+    return popped;
+  }
+
+ private:
+  // Yields before a waiting side goes to sleep
+  static const int SPIN_LIMIT = 64;
+
+  std::vector<T> m_slots;
+  std::size_t m_mask;
+  std::atomic<std::size_t> m_head;
+  std::atomic<std::size_t> m_tail;
+  std::atomic<bool> m_closed;
+  std::atomic<int> m_sleepers;
+  std::mutex m_mutex;
+  std::condition_variable m_wakeup;
+
+  bool pushOne(T& item) {
+    std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    if ( tail - m_head.load(std::memory_order_acquire) > m_mask ) return false;
+    m_slots[tail & m_mask] = std::move(item);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool popOne(T& item) {
+    std::size_t head = m_head.load(std::memory_order_relaxed);
+    if ( head == m_tail.load(std::memory_order_acquire) ) return false;
+    item = std::move(m_slots[head & m_mask]);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Calls ready() until it returns true, spinning first and then sleeping until the other side calls wake().
+  // The fences here and in wake() make sure that either the sleeper sees the other side's progress when it
+  // checks ready() under the mutex, or the other side sees the sleeper and notifies it.
+  template <typename Ready>
+  void waitUntil(Ready ready) {
+    for ( int spin = 0; spin < SPIN_LIMIT; spin++ ) {
+      if ( ready() ) return;
+      std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_sleepers.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while ( !ready() ) m_wakeup.wait(lock);
+    m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // Called after every change of the head, tail or closed flag
+  void wake() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if ( m_sleepers.load(std::memory_order_relaxed) == 0 ) return;
+    // Taking the mutex waits for a sleeper that has checked ready() to be inside wait()
+    { std::lock_guard<std::mutex> lock(m_mutex); }
+    m_wakeup.notify_all();
+  }
+};
+
+#endif // BOUNDED_QUEUE
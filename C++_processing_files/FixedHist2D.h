@@ -0,0 +1,295 @@
+#ifndef FIXED_HIST_2D
+#define FIXED_HIST_2D
+
+#include <array>
+#include <vector>
+#include <ostream>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+#include "Hist2D.h"
+
+// FixedHist2D is a Hist2D whose bins are fixed at compile time, for grids that never change such as the
+// 15 x 25 grid of demo.cpp. Its counts, guard bins included, live inline in a std::array, so a histogram is
+// one flat block with no heap allocation, and an array of them (one per group) holds no pointers to chase.
+// Edges, bin widths and their reciprocals are compile-time constants, so binning a point is a multiply,
+// a ceil and at most one comparison against a constant edge, with no lookup tables or branches on the layout.
+//
+// The bins come from a Geometry type with static constexpr members, evenly spaced like the first Hist2D constructor:
+//
+//   struct RankGrid {
+//     static constexpr int xBins = 15;
+//     static constexpr int yBins = 25;
+//     static constexpr double xMin = -.1, xMax = 15.1, yMin = -.1, yMax = 25.1;
+//   };
+//   FixedHist2D<int, RankGrid> hist;
+//   hist.addToHist(series, Hist2DAlignment::Alignment::Front);
+//
+// Binning, alignments and out-of-range handling give the counts a Hist2D with the same bins would, barring values
+// within an ulp of an edge (see sameLayout), and print() writes the same text, so the two can be used side by side:
+// merge() takes either kind, mergeInto() adds a FixedHist2D to a Hist2D, and toHist2D() makes the dynamic copy
+// that the tools built on Hist2D (binary output, distances, densities) expect. Quantile sketches and widening of
+// counters on overflow are not available here; counters behave like plain CountT arithmetic.
+
+// Edge k of bins even bins over [min, max], by the same formula as the Hist2D constructor
+constexpr double fixedHistEdge(double min, double max, int bins, int k)
+{
+  return min + k*((max - min)/bins);
+}
+
+template <typename T, typename Geometry, typename CountT = T>
+class FixedHist2D : public Hist2DAlignment
+{
+  static_assert(std::is_arithmetic<T>::value && std::is_arithmetic<CountT>::value, "FixedHist2D needs arithmetic T and CountT");
+  static_assert(Geometry::xBins > 0 && Geometry::yBins > 0, "FixedHist2D needs at least one bin on each axis");
+  static_assert(Geometry::xMax > Geometry::xMin && Geometry::yMax > Geometry::yMin, "FixedHist2D needs max above min on each axis");
+
+ public:
+  typedef CountT count_type;
+  typedef typename Hist2D<T, CountT>::total_type total_type;
+  typedef Hist2D<T, CountT> dynamic_type;
+
+  static constexpr int X_BINS = Geometry::xBins;
+  static constexpr int Y_BINS = Geometry::yBins;
+
+  FixedHist2D() : m_counts() {}
+
+  void addToHist(const NumericVector<T>& numVector, Alignment alignment, CountT weight = 1) {
+    addSeries(numVector.getYConst().data(), numVector.getXConst().data(), numVector.getYConst().size(),
+	      numVector.m_maxY, numVector.m_minY, alignment, weight);
+  }
+
+  void addToHist(const NumericSeriesView<T>& view, Alignment alignment, CountT weight = 1) {
+    addSeries(view.getYData(), view.getXData(), view.length, view.m_maxY, view.m_minY, alignment, weight);
+  }
+
+  void addToHist(const VectorOfNumericVectors<T>& listOfVectors, Alignment alignment) {
+    for ( const auto& series: listOfVectors.getVector() ) addToHist(series, alignment);
+  }
+
+  void addToHist(const FlatVectorOfNumericVectors<T>& listOfVectors, Alignment alignment) {
+    for ( std::size_t i = 0; i < listOfVectors.size(); i++ ) addToHist(listOfVectors[i], alignment);
+  }
+
+  std::vector<double> getXEdges() const { return edges<true>(); }
+  std::vector<double> getYEdges() const { return edges<false>(); }
+  int getXBins() const { return X_BINS; }
+  int getYBins() const { return Y_BINS; }
+  std::size_t countBytes() const { return sizeof(m_counts); }
+
+  // Count of the bin at row yBin and column xBin; as with Hist2D, rows -1 and getYBins() and
+  // columns -1 and getXBins() are the guard bins holding dropped points
+  total_type getCount(int yBin, int xBin) const { return m_counts[index(yBin + 1, xBin + 1)]; }
+  void setCount(int yBin, int xBin, total_type count) { m_counts[index(yBin + 1, xBin + 1)] = (CountT) count; }
+
+  // Same out-of-range handling as Hist2D (see OutOfRangeMode)
+  void setOutOfRangeMode(OutOfRangeMode mode) { m_outOfRange = mode; }
+  OutOfRangeMode getOutOfRangeMode() const { return m_outOfRange; }
+  std::uint64_t getDroppedPoints() const { return m_dropped; }
+  std::uint64_t getClampedPoints() const { return m_clamped; }
+  void setOutOfRangePoints(std::uint64_t dropped, std::uint64_t clamped) {
+    m_dropped = dropped;
+    m_clamped = clamped;
+  }
+
+  // True if other has the bins of Geometry, so the two can be merged. Edges are compared to within rounding:
+  // a compiler contracting min + k * width into a fused multiply-add can move a Hist2D edge by one ulp.
+  bool sameLayout(const dynamic_type& other) const {
+    return other.getXBins() == X_BINS && other.getYBins() == Y_BINS &&
+      closeEdges(other.getXEdges(), getXEdges()) && closeEdges(other.getYEdges(), getYEdges());
+  }
+
+  void merge(const FixedHist2D& other) {
+    for ( std::size_t i = 0; i < CELLS; i++ ) m_counts[i] += other.m_counts[i];
+    m_dropped += other.m_dropped;
+    m_clamped += other.m_clamped;
+  }
+
+  // Adds the counts of a Hist2D with the same bins, otherwise std::invalid_argument is thrown
+  void merge(const dynamic_type& other) {
+    if ( !sameLayout(other) ) {
+      throw std::invalid_argument("FixedHist2D merge requires a Hist2D with the same bin layout");
+    }
+    for ( int y = -1; y <= Y_BINS; y++ ) {
+      for ( int x = -1; x <= X_BINS; x++ ) m_counts[index(y + 1, x + 1)] += (CountT) other.getCount(y, x);
+    }
+    m_dropped += other.getDroppedPoints();
+    m_clamped += other.getClampedPoints();
+  }
+
+  FixedHist2D& operator+=(const FixedHist2D& other) {
+    merge(other);
+    return *this;
+  }
+
+  FixedHist2D& operator+=(const dynamic_type& other) {
+    merge(other);
+    return *this;
+  }
+
+  // Adds these counts to a Hist2D with the same bins, otherwise std::invalid_argument is thrown
+  void mergeInto(dynamic_type& target) const {
+    if ( !sameLayout(target) ) {
+      throw std::invalid_argument("FixedHist2D merge requires a Hist2D with the same bin layout");
+    }
+    for ( int y = -1; y <= Y_BINS; y++ ) {
+      for ( int x = -1; x <= X_BINS; x++ ) {
+	total_type count = getCount(y, x);
+	if ( count != 0 ) target.setCount(y, x, target.getCount(y, x) + count);
+      }
+    }
+    target.setOutOfRangePoints(target.getDroppedPoints() + m_dropped, target.getClampedPoints() + m_clamped);
+  }
+
+  // A Hist2D with the same bins, counts and settings
+  dynamic_type toHist2D() const {
+    dynamic_type hist(X_BINS, Y_BINS, Geometry::xMin, Geometry::xMax, Geometry::yMin, Geometry::yMax);
+    hist.setOutOfRangeMode(m_outOfRange);
+    mergeInto(hist);
+    return hist;
+  }
+
+  void subtract(const FixedHist2D& other) {
+    for ( std::size_t i = 0; i < CELLS; i++ ) m_counts[i] -= other.m_counts[i];
+    m_dropped -= other.m_dropped;
+    m_clamped -= other.m_clamped;
+  }
+
+  FixedHist2D& operator-=(const FixedHist2D& other) {
+    subtract(other);
+    return *this;
+  }
+
+  void clear() {
+    m_counts.fill(0);
+    m_dropped = 0;
+    m_clamped = 0;
+  }
+
+  // Same text as Hist2D::print
+  void print(std::ostream& os) const {
+    os << "xbins, ybins, xmin, xmax, ymin, ymax" << std::endl;
+    os << X_BINS << ", " << Y_BINS << ", " << (T) Geometry::xMin << ", " << (T) Geometry::xMax << ", "
+       << (T) Geometry::yMin << ", " << (T) Geometry::yMax << std::endl;
+    for ( int i = 0; i < Y_BINS; i++ ) {
+      for ( int j = 0; j < X_BINS - 1; j++ ) {
+	os << " " << getCount(i, j) << ",  ";
+      }
+      os << " " << getCount(i, X_BINS - 1);
+      os << std::endl;
+    }
+  }
+
+ private:
+  // Storage has one guard row and column on each side, so bin k is row or column k + 1 as in Hist2D
+  static constexpr std::size_t ROW = X_BINS + 2;
+  static constexpr std::size_t CELLS = (std::size_t) (Y_BINS + 2) * ROW;
+
+  std::array<CountT, CELLS> m_counts;
+  OutOfRangeMode m_outOfRange = OutOfRangeMode::Drop;
+  std::uint64_t m_dropped = 0;
+  std::uint64_t m_clamped = 0;
+
+  static bool closeEdges(const std::vector<double>& a, const std::vector<double>& b) {
+    double tolerance = 1e-9*(b.back() - b.front());
+    for ( std::size_t k = 0; k < b.size(); k++ ) {
+      if ( !(std::fabs(a[k] - b[k]) <= tolerance) ) return false;
+    }
+    return true;
+  }
+
+  static std::size_t index(int row, int column) { return (std::size_t) row * ROW + column; }
+
+  template <bool IsX>
+  static constexpr int bins() { return IsX ? X_BINS : Y_BINS; }
+
+  template <bool IsX>
+  static constexpr double edge(int k) {
+    return IsX ? fixedHistEdge(Geometry::xMin, Geometry::xMax, X_BINS, k) : fixedHistEdge(Geometry::yMin, Geometry::yMax, Y_BINS, k);
+  }
+
+  // Bins per unit, from the computed end edges like Hist2D's lookup
+  template <bool IsX>
+  static constexpr double invInc() { return bins<IsX>() / (edge<IsX>(bins<IsX>()) - edge<IsX>(0)); }
+
+  // Bin of v with the same result as Hist2D's binning: the bin k with edge k < v <= edge k + 1,
+  // -1 below the first edge and bins past the last. The arithmetic guess is off by at most one step
+  // from rounding, so each correcting loop runs at most once. NaN and infinite values get the underflow bin -1.
+  template <bool IsX>
+  static int binOf(double v) {
+    if ( !std::isfinite(v) ) return -1;
+    double guess = std::ceil((v - edge<IsX>(0))*invInc<IsX>());
+    int k = (int) std::min(std::max(guess, 0.0), (double) (bins<IsX>() + 1)) - 1;
+    while ( k >= 0 && edge<IsX>(k) >= v ) --k;
+    while ( k < bins<IsX>() && edge<IsX>(k + 1) < v ) ++k;
+    return k;
+  }
+
+  template <bool IsX>
+  std::vector<double> edges() const {
+    std::vector<double> result(bins<IsX>() + 1);
+    for ( int k = 0; k <= bins<IsX>(); k++ ) result[k] = edge<IsX>(k);
+    return result;
+  }
+
+  void addSeries(const T* toAddY, const T* toAddX, int n, T maxY, T minY, Alignment alignment, CountT weight) {
+    INSTRUMENT_SCOPE(Bin);
+    if ( m_outOfRange == OutOfRangeMode::Clamp ) {
+      addPoints<OutOfRangeMode::Clamp>(toAddY, toAddX, n, maxY, minY, alignment, weight);
+    } else {
+      addPoints<OutOfRangeMode::Drop>(toAddY, toAddX, n, maxY, minY, alignment, weight);
+    }
+  }
+
+  // The alignments start where Hist2D::addToHist starts them
+  template <OutOfRangeMode Mode>
+  void addPoints(const T* toAddY, const T* toAddX, int n, T maxY, T minY, Alignment alignment, CountT weight) {
+    int start;
+    switch ( alignment ) {
+    case Alignment::Front :
+      start = 0;
+      break;
+    case Alignment::Back :
+      start = Y_BINS - n;
+      break;
+    case Alignment::AtMax :
+      start = Y_BINS/2 - (std::find(toAddY, toAddY + n, maxY) - toAddY);
+      break;
+    case Alignment::AtMin :
+      start = Y_BINS/2 - (std::find(toAddY, toAddY + n, minY) - toAddY);
+      break;
+    case Alignment::ByX :
+      for ( int j = 0; j < n; j++ ) {
+	addPoint<Mode>(binOf<false>(toAddY[j]), binOf<true>(toAddX[j]), isFinite(toAddY[j]) && isFinite(toAddX[j]), weight);
+      }
+      return;
+    default:
+      std::cout << "Improper alignment parameter in FixedHist2D addToHist method" << std::endl;
+      return;
+    }
+    for ( int j = 0; j < n; j++ ) addPoint<Mode>(binOf<false>(toAddY[j]), binOf<true>(start + j), isFinite(toAddY[j]), weight);
+  }
+
+  template <typename V>
+  static bool isFinite(V v) { return !std::is_floating_point<V>::value || std::isfinite((double) v); }
+
+  // Counts one point with bin indices in [-1, bins], with no branches on where it falls.
+  // As in Hist2D, a point with a NaN or infinite value is dropped whatever the mode.
+  template <OutOfRangeMode Mode>
+  void addPoint(int yBin, int xBin, bool finite, CountT weight) {
+    std::uint64_t outside = ((unsigned) yBin >= (unsigned) Y_BINS) | ((unsigned) xBin >= (unsigned) X_BINS);
+    if ( Mode == OutOfRangeMode::Clamp && finite ) {
+      m_clamped += outside;
+      yBin = std::min(std::max(yBin, 0), Y_BINS - 1);
+      xBin = std::min(std::max(xBin, 0), X_BINS - 1);
+    } else {
+      m_dropped += outside;
+    }
+    m_counts[index(yBin + 1, xBin + 1)] += weight;
+  }
+};
+
+#endif // FIXED_HIST_2D
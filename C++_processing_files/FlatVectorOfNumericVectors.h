@@ -0,0 +1,230 @@
+#ifndef FLAT_VECTOR_NUMERIC_VECTORS
+#define FLAT_VECTOR_NUMERIC_VECTORS
+
+#include <vector>
+#include <limits>
+#include <iostream>
+#include <algorithm>
+
+#include "NumericVector.h"
+
+// NumericSeriesView is a non-owning view of one series (or of a run of series) stored elsewhere,
+// typically in a FlatVectorOfNumericVectors. It carries the same public extremes as NumericVector
+// so Hist2D can bin it directly, and computes summary statistics on demand without copying the data.
+// A view is only valid while the storage it points into is alive and unchanged.
+template <typename T,
+  typename = typename std::enable_if<std::is_arithmetic<T>::value, T>::type>
+  class NumericSeriesView
+  {
+  public:
+  T m_maxY;
+  T m_minY;
+  T m_maxX;
+  T m_minX;
+  int length;
+
+  NumericSeriesView()
+  : m_maxY(0), m_minY(0), m_maxX(0), m_minX(0), length(0), m_y(nullptr), m_x(nullptr) {}
+
+  NumericSeriesView(const T* y, const T* x, int n, T maxY, T minY, T maxX, T minX)
+  : m_maxY(maxY), m_minY(minY), m_maxX(maxX), m_minX(minX), length(n), m_y(y), m_x(x) {}
+
+  const T* getYData() const { return m_y; }
+  const T* getXData() const { return m_x; }
+
+  // Summary statistics for the y values, matching NumericVector
+  double getMean() const {
+    if ( length == 0 ) return -999.0;
+    return std::accumulate(m_y, m_y + length, 0.0) / length;
+  }
+
+  // Population variance, as NumericVector::getSD reports it
+  double getSD() const {
+    if ( length == 0 ) return -999.0;
+    double mean = getMean();
+    double square_sum = 0.0;
+    for ( int i = 0; i < length; i++ ) {
+      square_sum += (m_y[i] - mean) * (m_y[i] - mean);
+    }
+    return square_sum / length;
+  }
+
+  // Same definition as NumericVector::getInflectionCount
+  int getInflectionCount() const {
+    int count = 0;
+    if ( length < 3 ) return count;
+    bool previous = m_y[1] < 0;
+    for ( int i = 2; i < length; i++ ) {
+      bool current = (m_y[i] - m_y[i-1]) < 0;
+      if ( current != previous ) count += 1;
+      previous = current;
+    }
+    return count;
+  }
+
+  int getUniqueCount() const {
+    if ( length <= SMALL_SERIES_LENGTH ) return countUniqueSmall(m_y, length);
+    std::vector<T> sorted(m_y, m_y + length);
+    std::sort(sorted.begin(), sorted.end());
+    return std::unique(sorted.begin(), sorted.end()) - sorted.begin();
+  }
+
+  // Same 9-element layout as NumericVector::getAllData
+  const std::vector<double> getAllData() const {
+    std::vector<double> result(9);
+    computeSeriesStats(m_y, m_x, length, result.data());
+    result[6] = getUniqueCount();
+    return result;
+  }
+
+  void print(std::ostream& os) const {
+    os << "Y values" << std::endl;
+    printArray(os, m_y);
+    os << "X values" << std::endl;
+    printArray(os, m_x);
+  }
+
+  private:
+  const T* m_y;
+  const T* m_x;
+
+  void printArray(std::ostream& os, const T* v) const {
+    for ( int i = 0; i < length - 1; i++ ) {
+      os << v[i] << ", ";
+    }
+    if ( length > 0 ) os << v[length-1];
+    os << std::endl;
+  }
+  };
+
+// Views the equal-length, non-empty vectors y and x as one series, e.g. a parsed row, without copying them
+template <typename T>
+NumericSeriesView<T> seriesView(const std::vector<T>& y, const std::vector<T>& x)
+{
+  auto yRange = std::minmax_element(y.begin(), y.end());
+  auto xRange = std::minmax_element(x.begin(), x.end());
+  return NumericSeriesView<T>(y.data(), x.data(), y.size(), *yRange.second, *yRange.first, *xRange.second, *xRange.first);
+}
+
+/*
+FlatVectorOfNumericVectors is a columnar alternative to VectorOfNumericVectors for large numbers of short series.
+All y values and all x values live in two contiguous arrays, and series i occupies [offsets[i], offsets[i+1])
+of both (compressed sparse row layout). Per-series extremes are kept alongside the offsets, so a series costs
+one offset and four values of bookkeeping instead of five heap-allocated vectors.
+Series are read back as NumericSeriesViews, and because the arrays are already contiguous, getConcatenated()
+is a view over the whole store rather than a copy.
+ */
+template <typename T,
+typename = typename std::enable_if<std::is_arithmetic<T>::value, T>::type>
+class FlatVectorOfNumericVectors
+{
+ public:
+  FlatVectorOfNumericVectors()
+    : m_offsets(1, 0),
+    m_maxLength(0), m_minLength(std::numeric_limits<int>::max()),
+    m_maxY(std::numeric_limits<T>::lowest()), m_minY(std::numeric_limits<T>::max()),
+    m_maxX(std::numeric_limits<T>::lowest()), m_minX(std::numeric_limits<T>::max())
+    {}
+
+  // Reserves room for the given number of series and total points
+  void reserve(std::size_t series, std::size_t points) {
+    m_offsets.reserve(series + 1);
+    m_extremes.reserve(series);
+    m_y.reserve(points);
+    m_x.reserve(points);
+  }
+
+  // Removes all series but keeps the allocated storage, so a store can be refilled without allocating
+  void clear() {
+    m_y.clear();
+    m_x.clear();
+    m_offsets.assign(1, 0);
+    m_extremes.clear();
+    m_maxLength = 0;
+    m_minLength = std::numeric_limits<int>::max();
+    m_maxY = std::numeric_limits<T>::lowest();  m_minY = std::numeric_limits<T>::max();
+    m_maxX = std::numeric_limits<T>::lowest();  m_minX = std::numeric_limits<T>::max();
+  }
+
+  // Appends a series given as n paired y and x values. Empty series are ignored.
+  void AddToVector(const T* y, const T* x, int n) {
+    if ( n <= 0 ) return;
+    Extremes e;
+    auto yRange = std::minmax_element(y, y + n);
+    auto xRange = std::minmax_element(x, x + n);
+    e.minY = *yRange.first;  e.maxY = *yRange.second;
+    e.minX = *xRange.first;  e.maxX = *xRange.second;
+    m_y.insert(m_y.end(), y, y + n);
+    m_x.insert(m_x.end(), x, x + n);
+    m_offsets.push_back(m_y.size());
+    m_extremes.push_back(e);
+
+    m_maxLength = std::max(m_maxLength, n);
+    m_minLength = std::min(m_minLength, n);
+    m_maxY = std::max(m_maxY, e.maxY);
+    m_minY = std::min(m_minY, e.minY);
+    m_maxX = std::max(m_maxX, e.maxX);
+    m_minX = std::min(m_minX, e.minX);
+  }
+
+  void AddToVector(const std::vector<T>& y, const std::vector<T>& x) {
+    AddToVector(y.data(), x.data(), y.size());
+  }
+
+  void AddToVector(const NumericVector<T>& list) {
+    AddToVector(list.getYConst(), list.getXConst());
+  }
+
+  // Number of series stored
+  std::size_t size() const { return m_extremes.size(); }
+  // Total number of points over all series
+  std::size_t points() const { return m_y.size(); }
+
+  // View of series i
+  NumericSeriesView<T> operator[](std::size_t i) const {
+    const Extremes& e = m_extremes[i];
+    return NumericSeriesView<T>(m_y.data() + m_offsets[i], m_x.data() + m_offsets[i], m_offsets[i+1] - m_offsets[i],
+				e.maxY, e.minY, e.maxX, e.minX);
+  }
+
+  // View of all series end to end. No copy is made.
+  NumericSeriesView<T> getConcatenated() const {
+    return NumericSeriesView<T>(m_y.data(), m_x.data(), m_y.size(), m_maxY, m_minY, m_maxX, m_minX);
+  }
+
+  const std::vector<T>& getYConst() const { return m_y; }
+  const std::vector<T>& getXConst() const { return m_x; }
+  const std::vector<std::size_t>& getOffsets() const { return m_offsets; }
+
+  // Same layout as VectorOfNumericVectors::getSummaryVals
+  const std::vector<double> getSummaryVals() const {
+    return std::vector<double> {(double) m_maxLength, (double) m_minLength, (double) m_maxY, (double) m_minY, (double) m_maxX, (double) m_minX};
+  }
+
+  void print(std::ostream& os) const {
+    for ( std::size_t i = 0; i < size(); i++ ) {
+      (*this)[i].print(os);
+    }
+  }
+
+ private:
+  struct Extremes {
+    T maxY;
+    T minY;
+    T maxX;
+    T minX;
+  };
+
+  std::vector<T> m_y;
+  std::vector<T> m_x;
+  std::vector<std::size_t> m_offsets;
+  std::vector<Extremes> m_extremes;
+  int  m_maxLength;
+  int  m_minLength;
+  T    m_maxY;
+  T    m_minY;
+  T    m_maxX;
+  T    m_minX;
+};
+
+#endif // FLAT_VECTOR_NUMERIC_VECTORS
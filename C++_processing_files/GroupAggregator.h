@@ -0,0 +1,344 @@
+#ifndef GROUP_AGGREGATOR
+#define GROUP_AGGREGATOR
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <cmath>
+#include <stdexcept>
+
+#include "NumericVector.h"
+#include "Hist2D.h"
+#include "GroupIndex.h"
+#include "BinaryOutput.h"
+#include "Snapshot.h"
+#include "Instrumentation.h"
+
+// GroupAggregator keeps one Hist2D and one list of per-series traits (see NumericVector::getAllData)
+// for every group key it sees, e.g. one per subreddit. Keys are interned into dense ids by a GroupIndex
+// and all per-group state is held in arrays indexed by id, so a row costs one hash of its key. All histograms share the bin layout and
+// alignment given at construction, so aggregators built over different parts of the input
+// can be merged back together with merge().
+// By default the traits are kept in memory until write(). After streamTraits(), traits rows are instead
+// formatted into a small per-group buffer and appended to the group's traits file whenever the buffer
+// fills, so memory use no longer grows with the input (see StreamingPipeline.h).
+template <typename T>
+class GroupAggregator
+{
+ public:
+  typedef typename Hist2D<T>::Alignment Alignment;
+
+  GroupAggregator(int xBins, int yBins, double xMin, double xMax, double yMin = -.1, double yMax = 25.1,
+		  Alignment alignment = Alignment::Front)
+    : m_xBins(xBins), m_yBins(yBins), m_xMin(xMin), m_xMax(xMax), m_yMin(yMin), m_yMax(yMax), m_alignment(alignment)
+  {}
+
+  // Returns the dense id of a group, creating the group's histogram and traits on first sight
+  int groupId(const FieldView& key) {
+    int id = m_groups.intern(key);
+    if ( (std::size_t) id == m_histograms.size() ) addGroup();
+    return id;
+  }
+
+  int groupId(const std::string& key) { return groupId(FieldView(key.data(), key.size())); }
+
+  // Adds one series (a NumericVector or a NumericSeriesView) to the histogram of its group and records its traits
+  template <typename Series>
+  void addSeries(int id, Series& series) {
+    m_histograms[id]->addToHist(series, m_alignment);
+    m_seriesCounts[id] += 1;
+    m_pointCounts[id] += series.length;
+    INSTRUMENT_COUNT(Series, 1);
+    INSTRUMENT_COUNT(Points, series.length);
+    INSTRUMENT_MAX(LongestSeries, series.length);
+    INSTRUMENT_SCOPE(Traits);
+    if ( m_streamDir.empty() ) {
+      m_traits[id].push_back(series.getAllData());
+    } else {
+      TraitsBuffer& buffer = m_traitsBuffers[id];
+      appendTraitsRow(buffer.text, series.getAllData());
+      if ( buffer.text.size() >= m_chunkBytes ) flushTraits(id);
+    }
+  }
+
+  template <typename Series>
+  void addSeries(const FieldView& key, Series& series) { addSeries(groupId(key), series); }
+
+  template <typename Series>
+  void addSeries(const std::string& key, Series& series) { addSeries(groupId(key), series); }
+
+  // Switches to streaming traits: rows go to <outputDir><group>_traits_.csv in chunks of about chunkBytes.
+  // Must be called before the first series is added. A streaming aggregator cannot be merged.
+  void streamTraits(const std::string& outputDir, std::size_t chunkBytes = 1 << 16) {
+    m_streamDir  = outputDir;
+    m_chunkBytes = chunkBytes;
+  }
+
+  // Keeps a quantile sketch of y per x bin in every group's histogram (see Hist2D::trackQuantiles),
+  // for writeQuantiles(). Must be called before the first series is added.
+  void trackQuantiles(int k = 200) {
+    m_quantileK = k;
+    for ( auto& hist: m_histograms ) hist->trackQuantiles(k);
+  }
+
+  // Folds other into this aggregator. Traits of other are appended after the traits
+  // already held here, so merging shards in input order reproduces the serial result exactly.
+  // Both aggregators must keep quantile sketches of the same size or none, otherwise std::invalid_argument is thrown.
+  void merge(GroupAggregator& other) {
+    if ( m_quantileK != other.m_quantileK ) {
+      throw std::invalid_argument("GroupAggregator merge requires both aggregators to track quantiles alike");
+    }
+    for ( std::size_t theirs = 0; theirs < other.m_groups.size(); theirs++ ) {
+      int mine = groupId(other.m_groups.keyView(theirs));
+      if ( m_seriesCounts[mine] == 0 ) {
+	m_histograms[mine].swap(other.m_histograms[theirs]);
+      } else {
+	*m_histograms[mine] += *other.m_histograms[theirs];
+      }
+      std::vector<std::vector<double>>& traits = m_traits[mine];
+      if ( traits.empty() ) {
+	traits.swap(other.m_traits[theirs]);
+      } else {
+	traits.insert(traits.end(), std::make_move_iterator(other.m_traits[theirs].begin()),
+		      std::make_move_iterator(other.m_traits[theirs].end()));
+      }
+      m_seriesCounts[mine] += other.m_seriesCounts[theirs];
+      m_pointCounts[mine] += other.m_pointCounts[theirs];
+    }
+    other.m_groups = GroupIndex();
+    other.m_histograms.clear();
+    other.m_traits.clear();
+    other.m_seriesCounts.clear();
+    other.m_pointCounts.clear();
+    other.m_traitsBuffers.clear();
+  }
+
+  // Appends the complete state for a snapshot (see Snapshot.h): the bins and alignment, then every group's
+  // key, series and point counts, histogram counts (guard bins included), out-of-range point counts and traits.
+  // Streamed traits and quantile sketches are not held in memory in a form a snapshot can keep,
+  // so std::invalid_argument is thrown for them.
+  void appendState(BinaryBuffer& buffer) const {
+    if ( !m_streamDir.empty() || m_quantileK != 0 ) {
+      throw std::invalid_argument("GroupAggregator snapshots do not support streamed traits or quantile sketches");
+    }
+    buffer.putU32(m_xBins);
+    buffer.putU32(m_yBins);
+    buffer.putDouble(m_xMin);
+    buffer.putDouble(m_xMax);
+    buffer.putDouble(m_yMin);
+    buffer.putDouble(m_yMax);
+    buffer.putU32((std::uint32_t) m_alignment);
+    buffer.putU32(m_groups.size());
+    for ( std::size_t id = 0; id < m_groups.size(); id++ ) {
+      FieldView key = m_groups.keyView(id);
+      buffer.putU32(key.size);
+      buffer.putBytes(key.data, key.size);
+      buffer.putU64(m_seriesCounts[id]);
+      buffer.putU64(m_pointCounts[id]);
+      const Hist2D<T>& hist = *m_histograms[id];
+      for ( int y = -1; y <= m_yBins; y++ ) {
+	for ( int x = -1; x <= m_xBins; x++ ) buffer.putDouble((double) hist.getCount(y, x));
+      }
+      buffer.putU64(hist.getDroppedPoints());
+      buffer.putU64(hist.getClampedPoints());
+      appendTraits(buffer, m_traits[id]);
+    }
+  }
+
+  // Replaces all groups with those of a snapshot written by appendState. Returns false, leaving this
+  // aggregator unchanged, if the snapshot is malformed or was taken with other bins or another alignment.
+  bool restoreState(SnapshotReader& in) {
+    int xBins = in.u32(), yBins = in.u32();
+    double xMin = in.f64(), xMax = in.f64(), yMin = in.f64(), yMax = in.f64();
+    std::uint32_t alignment = in.u32();
+    if ( !in.ok() || xBins != m_xBins || yBins != m_yBins || xMin != m_xMin || xMax != m_xMax ||
+	 yMin != m_yMin || yMax != m_yMax || alignment != (std::uint32_t) m_alignment ) return false;
+
+    GroupAggregator restored(m_xBins, m_yBins, m_xMin, m_xMax, m_yMin, m_yMax, m_alignment);
+    std::uint32_t groups = in.u32();
+    for ( std::uint32_t g = 0; g < groups && in.ok(); g++ ) {
+      FieldView key = in.bytes(in.u32());
+      if ( !in.ok() ) return false;
+      int id = restored.groupId(key);
+      restored.m_seriesCounts[id] = in.u64();
+      restored.m_pointCounts[id] = in.u64();
+      Hist2D<T>& hist = *restored.m_histograms[id];
+      for ( int y = -1; y <= m_yBins; y++ ) {
+	for ( int x = -1; x <= m_xBins; x++ ) hist.setCount(y, x, in.f64());
+      }
+      std::uint64_t dropped = in.u64();
+      hist.setOutOfRangePoints(dropped, in.u64());
+      std::uint64_t rows = in.u64();
+      std::uint32_t columns = in.u32();
+      // Checked before allocating, so a bad count cannot ask for more memory than the snapshot holds
+      if ( !in.ok() || (columns != 0 && rows > in.remaining() / 8 / columns) ) return false;
+      // appendTraits stores the traits column by column
+      std::vector<std::vector<double>>& traits = restored.m_traits[id];
+      traits.assign(rows, std::vector<double>(columns));
+      for ( std::uint32_t column = 0; column < columns; column++ ) {
+	for ( std::uint64_t row = 0; row < rows; row++ ) traits[row][column] = in.f64();
+      }
+    }
+    if ( !in.ok() || !in.atEnd() ) return false;
+    *this = std::move(restored);
+    return true;
+  }
+
+  // Groups seen so far; ids run from 0 to getGroups().size() - 1
+  const GroupIndex& getGroups() const { return m_groups; }
+  const Hist2D<T>& getHistogram(int id) const { return *m_histograms[id]; }
+  const std::vector<std::vector<double>>& getTraits(int id) const { return m_traits[id]; }
+  // Number of series and of points added to a group
+  std::size_t getSeriesCount(int id) const { return m_seriesCounts[id]; }
+  std::size_t getPointCount(int id) const { return m_pointCounts[id]; }
+
+  // Saves each histogram to <outputDir><group><histComponent>.txt and
+  // the traits of every series in a group to <outputDir><group>_traits_.csv
+  void write(const std::string& outputDir, const std::string& histComponent) const {
+    INSTRUMENT_SCOPE(Write);
+    std::string filename;
+    std::ofstream myfile;
+    for ( std::size_t id = 0; id < m_groups.size(); id++ ) {
+      filename = outputDir + m_groups.key(id) + histComponent + ".txt";
+      myfile.open (filename);
+      m_histograms[id]->print(myfile);
+      INSTRUMENT_COUNT(BytesWritten, myfile.tellp());
+      myfile.close();
+    }
+    if ( !m_streamDir.empty() ) {
+      for ( std::size_t id = 0; id < m_groups.size(); id++ ) {
+	flushTraits(id);
+      }
+      return;
+    }
+    for ( std::size_t id = 0; id < m_groups.size(); id++ ) {
+      filename = outputDir + m_groups.key(id) + "_traits_.csv";
+      myfile.open (filename);
+      for ( auto it = m_traits[id].begin(); it!=m_traits[id].end(); ++it ) {
+	std::copy(it->begin(), it->end(), std::ostream_iterator<double>(myfile, ","));
+	myfile << std::endl;
+      }
+      INSTRUMENT_COUNT(BytesWritten, myfile.tellp());
+      myfile.close();
+    }
+  }
+
+  // Saves the quantiles qs of y in every x bin of each group to <outputDir><group><histComponent>_quantiles_.csv,
+  // one row per x bin: the bin's lower and upper x edges, then one column per quantile (NA for empty bins).
+  // Requires trackQuantiles(), otherwise std::invalid_argument is thrown.
+  void writeQuantiles(const std::string& outputDir, const std::string& histComponent,
+		      const std::vector<double>& qs = {.1, .25, .5, .75, .9}) const {
+    if ( m_quantileK == 0 ) throw std::invalid_argument("GroupAggregator writeQuantiles requires trackQuantiles");
+    INSTRUMENT_SCOPE(Write);
+    char number[32];
+    for ( std::size_t id = 0; id < m_groups.size(); id++ ) {
+      const Hist2D<T>& hist = *m_histograms[id];
+      std::string text = "xmin,xmax";
+      for ( double q: qs ) {
+	std::snprintf(number, sizeof(number), ",q%g", q);
+	text += number;
+      }
+      text += "\n";
+      for ( int x = 0; x < hist.getXBins(); x++ ) {
+	std::snprintf(number, sizeof(number), "%g,%g", hist.getXEdges()[x], hist.getXEdges()[x + 1]);
+	text += number;
+	for ( double value: hist.getQuantileSketch(x).quantiles(qs) ) {
+	  if ( std::isnan(value) ) text += ",NA";
+	  else {
+	    std::snprintf(number, sizeof(number), ",%g", value);
+	    text += number;
+	  }
+	}
+	text += "\n";
+      }
+      std::ofstream file(outputDir + m_groups.key(id) + histComponent + "_quantiles_.csv");
+      file.write(text.data(), text.size());
+      INSTRUMENT_COUNT(BytesWritten, text.size());
+    }
+  }
+
+  // Saves each group's histogram and traits to one binary file, <outputDir><group><histComponent>.h2b
+  // (see BinaryOutput.h). Traits that were streamed with streamTraits() stay in their text files.
+  // Returns false if any file could not be written; the other files are still written.
+  bool writeBinary(const std::string& outputDir, const std::string& histComponent) const {
+    INSTRUMENT_SCOPE(Write);
+    bool written = true;
+    for ( std::size_t id = 0; id < m_groups.size(); id++ ) {
+      written &= ::writeBinary(outputDir + m_groups.key(id) + histComponent + ".h2b", *m_histograms[id], m_traits[id]);
+    }
+    if ( !m_streamDir.empty() ) {
+      for ( std::size_t id = 0; id < m_groups.size(); id++ ) {
+	written &= flushTraits(id);
+      }
+    }
+    return written;
+  }
+
+ private:
+  int m_xBins;
+  int m_yBins;
+  double m_xMin;
+  double m_xMax;
+  double m_yMin;
+  double m_yMax;
+  Alignment m_alignment;
+  int m_quantileK = 0;             // sketch size of the per-x-bin quantiles, 0 when they are not kept
+
+  // Per-group state, indexed by the ids of m_groups
+  GroupIndex m_groups;
+  std::vector<std::unique_ptr<Hist2D<T>>> m_histograms;
+  std::vector<std::vector<std::vector<double>>> m_traits;
+  std::vector<std::size_t> m_seriesCounts;
+  std::vector<std::size_t> m_pointCounts;
+
+  // Pending traits rows of one group while streaming
+  struct TraitsBuffer {
+    std::string text;
+    bool started = false;    // the group's file has been created and later chunks are appended
+  };
+  std::string m_streamDir;
+  std::size_t m_chunkBytes = 0;
+  mutable std::vector<TraitsBuffer> m_traitsBuffers;
+
+  void addGroup() {
+    m_histograms.push_back(newHist());
+    m_traits.push_back(std::vector<std::vector<double>>());
+    m_seriesCounts.push_back(0);
+    m_pointCounts.push_back(0);
+    m_traitsBuffers.push_back(TraitsBuffer());
+  }
+
+  // Formats a traits row exactly as the ostream_iterator in write() does: each value in default
+  // (%g) notation followed by a comma, then a newline
+  static void appendTraitsRow(std::string& out, const std::vector<double>& row) {
+    char number[32];
+    for ( double value: row ) {
+      int length = std::snprintf(number, sizeof(number), "%g,", value);
+      out.append(number, length);
+    }
+    out.push_back('\n');
+  }
+
+  // Returns false if the file could not be written
+  bool flushTraits(int id) const {
+    TraitsBuffer& buffer = m_traitsBuffers[id];
+    if ( buffer.text.empty() && buffer.started ) return true;
+    std::ofstream file(m_streamDir + m_groups.key(id) + "_traits_.csv", buffer.started ? std::ios::app : std::ios::trunc);
+    file.write(buffer.text.data(), buffer.text.size());
+    INSTRUMENT_COUNT(BytesWritten, buffer.text.size());
+    buffer.text.clear();
+    buffer.started = true;
+    return (bool) file;
+  }
+
+  std::unique_ptr<Hist2D<T>> newHist() const {
+    std::unique_ptr<Hist2D<T>> hist(new Hist2D<T>(m_xBins, m_yBins, m_xMin, m_xMax, m_yMin, m_yMax));
+    if ( m_quantileK != 0 ) hist->trackQuantiles(m_quantileK);
+    return hist;
+  }
+};
+
+#endif // GROUP_AGGREGATOR
@@ -0,0 +1,164 @@
+#ifndef GROUP_INDEX
+#define GROUP_INDEX
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+
+#include "TSVReader.h"
+#include "TimeBuckets.h"
+
+// GroupIndex interns group keys into dense integer ids 0, 1, 2, ... in order of first appearance,
+// so per-group state can live in plain arrays indexed by id.
+// Keys are hashed straight from their raw bytes (e.g. a FieldView into the input) into an
+// open-addressing table with linear probing, and copied once into a single byte arena when first seen.
+// Looking up a key that is already known costs one hash and usually one memcmp, and never allocates.
+class GroupIndex
+{
+ public:
+  explicit GroupIndex(std::size_t expectedGroups = 64)
+    : m_keyOffsets(1, 0)
+  {
+    std::size_t capacity = 16;
+    while ( capacity < 2 * expectedGroups ) capacity <<= 1;
+    m_slots.assign(capacity, Slot());
+  }
+
+  // Returns the id of key, adding it as the next id if it has not been seen before
+  int intern(const char* data, std::size_t size) {
+    std::uint64_t hash = hashBytes(data, size);
+    std::size_t slot = probe(data, size, hash);
+    if ( m_slots[slot].id >= 0 ) return m_slots[slot].id;
+
+    int id = m_keyOffsets.size() - 1;
+    m_keys.append(data, size);
+    m_keyOffsets.push_back(m_keys.size());
+    m_slots[slot].hash = hash;
+    m_slots[slot].id   = id;
+    // Keeps the table at most half full so probe sequences stay short
+    if ( 2 * (std::size_t) (id + 1) > m_slots.size() ) grow();
+    return id;
+  }
+
+  int intern(const FieldView& key) { return intern(key.data, key.size); }
+  int intern(const std::string& key) { return intern(key.data(), key.size()); }
+
+  // Returns the id of key, or -1 if it has not been interned
+  int find(const char* data, std::size_t size) const {
+    return m_slots[probe(data, size, hashBytes(data, size))].id;
+  }
+
+  int find(const FieldView& key) const { return find(key.data, key.size); }
+  int find(const std::string& key) const { return find(key.data(), key.size()); }
+
+  // Number of distinct keys interned
+  std::size_t size() const { return m_keyOffsets.size() - 1; }
+
+  // The bytes of the key with the given id. The view is invalidated by the next call to intern().
+  FieldView keyView(int id) const {
+    return FieldView(m_keys.data() + m_keyOffsets[id], m_keyOffsets[id + 1] - m_keyOffsets[id]);
+  }
+
+  std::string key(int id) const { return keyView(id).str(); }
+
+ private:
+  struct Slot {
+    std::uint64_t hash = 0;
+    int id = -1;    // -1 marks an empty slot
+  };
+
+  std::vector<Slot> m_slots;            // size is always a power of two
+  std::string m_keys;                   // all keys end to end
+  std::vector<std::size_t> m_keyOffsets; // key i occupies [m_keyOffsets[i], m_keyOffsets[i+1]) of m_keys
+
+  // Returns the slot holding key, or the empty slot where it would be inserted
+  std::size_t probe(const char* data, std::size_t size, std::uint64_t hash) const {
+    std::size_t mask = m_slots.size() - 1;
+    std::size_t slot = hash & mask;
+    while ( true ) {
+      const Slot& s = m_slots[slot];
+      if ( s.id < 0 ) return slot;
+      if ( s.hash == hash && keyEquals(s.id, data, size) ) return slot;
+      slot = (slot + 1) & mask;
+    }
+  }
+
+  bool keyEquals(int id, const char* data, std::size_t size) const {
+    std::size_t begin = m_keyOffsets[id];
+    return m_keyOffsets[id + 1] - begin == size && std::memcmp(m_keys.data() + begin, data, size) == 0;
+  }
+
+  void grow() {
+    std::vector<Slot> old;
+    old.swap(m_slots);
+    m_slots.assign(old.size() * 2, Slot());
+    std::size_t mask = m_slots.size() - 1;
+    for ( const Slot& s: old ) {
+      if ( s.id < 0 ) continue;
+      std::size_t slot = s.hash & mask;
+      while ( m_slots[slot].id >= 0 ) slot = (slot + 1) & mask;
+      m_slots[slot] = s;
+    }
+  }
+
+  // FNV-1a style hash taken 8 bytes at a time, followed by a final mix so the low bits
+  // used to pick a slot depend on every input byte
+  static std::uint64_t hashBytes(const char* data, std::size_t size) {
+    const std::uint64_t prime = 0x100000001b3ULL;
+    std::uint64_t hash = 0xcbf29ce484222325ULL ^ size;
+    std::size_t i = 0;
+    for ( ; i + 8 <= size; i += 8 ) {
+      std::uint64_t word;
+      std::memcpy(&word, data + i, 8);
+      hash = (hash ^ word) * prime;
+    }
+    for ( ; i < size; i++ ) {
+      hash = (hash ^ (unsigned char) data[i]) * prime;
+    }
+    hash ^= hash >> 29;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 32;
+    return hash;
+  }
+};
+
+// Group key functions. Each maps a parsed row to the bytes of its group key, for use as
+//   aggregator.addSeries(groupKey(row), series)
+// so grouping on another column costs the same as grouping by subreddit.
+
+struct BySubreddit
+{
+  template <typename T>
+  FieldView operator()(const SeriesRow<T>& row) const { return row.subreddit; }
+};
+
+struct ByComp
+{
+  template <typename T>
+  FieldView operator()(const SeriesRow<T>& row) const { return row.comp; }
+};
+
+// Groups rows by the time bucket of their created column, e.g. ByCreatedBucket(24 * 60) for days.
+// The key is the start of the bucket in minutes since the epoch, written in decimal.
+// The returned view points into a per-thread buffer and is only valid until the next call on that thread.
+class ByCreatedBucket
+{
+ public:
+  explicit ByCreatedBucket(long long bucketMinutes, long long utcOffsetSeconds = 0)
+    : m_bucketMinutes(bucketMinutes), m_time(utcOffsetSeconds) {}
+
+  template <typename T>
+  FieldView operator()(const SeriesRow<T>& row) const {
+    static thread_local char text[24];
+    int length = std::snprintf(text, sizeof(text), "%lld", m_time.minutesSinceEpoch(row.created, m_bucketMinutes));
+    return FieldView(text, length);
+  }
+
+ private:
+  long long m_bucketMinutes;
+  TimeBuckets m_time;
+};
+
+#endif // GROUP_INDEX
@@ -0,0 +1,176 @@
+#ifndef HIST_2D_BANK
+#define HIST_2D_BANK
+
+#include <array>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "Hist2D.h"
+
+// Hist2DBank keeps one Hist2D per alignment in a set fixed at compile time, all with the same bins,
+// and fills them together. Each series is walked once: the y bin of every point and the positions of
+// the first maximum and minimum are computed a single time, and the points are then scattered into each
+// histogram of the bank in turn, with the x bins of each index alignment read from a precomputed position table.
+//
+//   Hist2DBank<int, int, Alignment::Front, Alignment::AtMax, Alignment::ByX> bank(15, 25, -.1, 15.1);
+//   bank.addToHist(series);
+//   bank.get(Alignment::AtMax).print(std::cout);
+template <typename T, typename CountT, Hist2DAlignment::Alignment... Alignments>
+class Hist2DBank
+{
+ public:
+  typedef Hist2DAlignment::Alignment Alignment;
+  typedef Hist2D<T, CountT> hist_type;
+  static const int size = sizeof...(Alignments);
+
+  Hist2DBank(int xBins=26, int yBins=28, double xMin = -.1, double xMax = 24, double yMin = -.1, double yMax = 25.1)
+    : m_hists{{makeHist(Alignments, xBins, yBins, xMin, xMax, yMin, yMax)...}}
+  {
+    buildPositionTable();
+  }
+
+  void addToHist(const NumericVector<T>& numVector, CountT weight = 1) {
+    addSeries(numVector.getYConst().data(), numVector.getXConst().data(), numVector.getYConst().size(), weight);
+  }
+
+  void addToHist(const NumericSeriesView<T>& view, CountT weight = 1) {
+    addSeries(view.getYData(), view.getXData(), view.length, weight);
+  }
+
+  void addToHist(const VectorOfNumericVectors<T>& listOfVectors) {
+    for ( const auto& series: listOfVectors.getVector() ) addToHist(series);
+  }
+
+  void addToHist(const FlatVectorOfNumericVectors<T>& listOfVectors) {
+    for ( std::size_t i = 0; i < listOfVectors.size(); i++ ) addToHist(listOfVectors[i]);
+  }
+
+  // Histogram for one of the bank's alignments. Asking for an alignment outside the bank throws std::invalid_argument.
+  const hist_type& get(Alignment alignment) const { return m_hists[indexOf(alignment)]; }
+  hist_type& get(Alignment alignment) { return m_hists[indexOf(alignment)]; }
+
+  // Histogram at position i of the alignment list
+  const hist_type& operator[](int i) const { return m_hists[i]; }
+
+  static Alignment alignmentAt(int i) {
+    static const Alignment alignments[] = {Alignments...};
+    return alignments[i];
+  }
+
+  // Keeps a quantile sketch per x bin in every histogram of the bank (see Hist2D::trackQuantiles)
+  void trackQuantiles(int k = 200) {
+    for ( auto& hist: m_hists ) hist.trackQuantiles(k);
+  }
+
+  // Sets what every histogram of the bank does with points outside its bins (see Hist2D::setOutOfRangeMode)
+  void setOutOfRangeMode(OutOfRangeMode mode) {
+    for ( auto& hist: m_hists ) hist.setOutOfRangeMode(mode);
+  }
+
+  void merge(const Hist2DBank& other) {
+    for ( int a = 0; a < size; a++ ) m_hists[a].merge(other.m_hists[a]);
+  }
+
+  Hist2DBank& operator+=(const Hist2DBank& other) {
+    merge(other);
+    return *this;
+  }
+
+ private:
+  std::array<hist_type, sizeof...(Alignments)> m_hists;
+  std::vector<int> m_yScratch;
+  std::vector<int> m_xScratch;
+  std::vector<int> m_positionScratch;   // x bins of an index alignment for the current series
+  std::vector<int> m_positionBins;
+  int m_positionLow;
+
+  // Histograms are built in place because boost::multi_array cannot be assigned across shapes
+  static hist_type makeHist(Alignment, int xBins, int yBins, double xMin, double xMax, double yMin, double yMax) {
+    return hist_type(xBins, yBins, xMin, xMax, yMin, yMax);
+  }
+
+  static int indexOf(Alignment alignment) {
+    for ( int a = 0; a < size; a++ ) {
+      if ( alignmentAt(a) == alignment ) return a;
+    }
+    throw std::invalid_argument("Hist2DBank does not hold the requested alignment");
+  }
+
+  void addSeries(const T* toAddY, const T* toAddX, int n, CountT weight) {
+    if ( n == 0 ) return;
+    // Every histogram shares the bins, so the y bins of the series are computed once from the first
+    const hist_type& first = m_hists[0];
+    m_yScratch.resize(n);
+    int yNonFinite = hist_type::binValues(toAddY, n, first.m_yVals, first.m_yUniform, first.m_yInvInc, m_yScratch.data());
+    int xNonFinite = 0;
+    if ( holdsByX() ) {
+      m_xScratch.resize(n);
+      xNonFinite = hist_type::binValues(toAddX, n, first.m_xVals, first.m_xUniform, first.m_xInvInc, m_xScratch.data());
+    }
+
+    // Positions of the first maximum and first minimum, found together in one pass
+    int maxIndex = 0, minIndex = 0;
+    for ( int j = 1; j < n; j++ ) {
+      if ( toAddY[j] > toAddY[maxIndex] ) maxIndex = j;
+      if ( toAddY[j] < toAddY[minIndex] ) minIndex = j;
+    }
+
+    m_positionScratch.resize(n);
+    int shape0 = first.m_yBins;
+    int starts[] = {startFor(Alignments, n, shape0, maxIndex, minIndex)...};
+
+    int a = 0;
+    int expand[] = {(addAligned(Alignments, a, starts[a], toAddY, toAddX, n, yNonFinite, xNonFinite, weight), ++a)...};
+    (void) expand;
+  }
+
+  // Scatters the series into the histogram of one alignment, whose x bins are the ByX bins or are read
+  // from the position table. Only ByX depends on the x values, and so on whether they are finite.
+  void addAligned(Alignment alignment, int a, int start, const T* toAddY, const T* toAddX, int n,
+		  int yNonFinite, int xNonFinite, CountT weight) {
+    if ( alignment == Alignment::ByX ) {
+      m_hists[a].place(toAddY, toAddX, m_yScratch.data(), m_xScratch.data(), n, yNonFinite + xNonFinite, weight);
+      return;
+    }
+    for ( int j = 0; j < n; j++ ) m_positionScratch[j] = positionBin(start + j);
+    m_hists[a].place(toAddY, nullptr, m_yScratch.data(), m_positionScratch.data(), n, yNonFinite, weight);
+  }
+
+  static bool holdsByX() {
+    for ( int a = 0; a < size; a++ ) {
+      if ( alignmentAt(a) == Alignment::ByX ) return true;
+    }
+    return false;
+  }
+
+  // x position of the first point of the series for each alignment, matching Hist2D::addToHist
+  static int startFor(Alignment alignment, int n, int shape0, int maxIndex, int minIndex) {
+    switch ( alignment ) {
+    case Alignment::Back :  return shape0 - n;
+    case Alignment::AtMax : return shape0/2 - maxIndex;
+    case Alignment::AtMin : return shape0/2 - minIndex;
+    default:                return 0;
+    }
+  }
+
+  // Index alignments place points at integer x positions, so the x bin of every integer position
+  // from just below the first edge to just above the last is tabulated once. Positions beyond the table
+  // fall in the same out-of-range bin as its end entries.
+  void buildPositionTable() {
+    const hist_type& first = m_hists[0];
+    m_positionLow = (int) std::floor(first.m_xVals.front()) - 1;
+    int high      = (int) std::ceil(first.m_xVals.back()) + 1;
+    m_positionBins.resize(high - m_positionLow + 1);
+    for ( int p = m_positionLow; p <= high; p++ ) {
+      m_positionBins[p - m_positionLow] = hist_type::binOne(first.m_xVals, first.m_xUniform, first.m_xInvInc, p);
+    }
+  }
+
+  int positionBin(int position) const {
+    int i = std::min(std::max(position - m_positionLow, 0), (int) m_positionBins.size() - 1);
+    return m_positionBins[i];
+  }
+};
+
+#endif // HIST_2D_BANK
@@ -0,0 +1,268 @@
+#ifndef HIST_DENSITY
+#define HIST_DENSITY
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "Hist2D.h"
+#include "BinaryOutput.h"
+
+// HistDensity turns the raw counts of a Hist2D into a smoothed, normalized density grid of floats that can be
+// plotted as is (see read_density_binary in R_plotting_files/read_hist_binary.R), so sparse groups
+// come out as a readable density rather than speckle, and R does no numerical work.
+//
+// Smoothing is a separable kernel, one pass along x and then one along y, with bandwidths in bins:
+//   Gaussian      standard deviation of bandwidth bins, truncated at 3 standard deviations
+//   Epanechnikov  weights 1 - (d / bandwidth)^2 for offsets |d| < bandwidth
+//   None          no smoothing; a bandwidth below one bin has the same effect for Epanechnikov
+// Near the edges of the grid each bin spreads its count over the bins that exist only, with the kernel
+// rescaled to match, so no mass is lost off the grid and edge bins are not darkened.
+// Each pass adds whole shifted rows scaled by one kernel weight, which vectorizes with AVX2 where available.
+//
+// The smoothed grid is then normalized:
+//   Global     the whole grid sums to 1, as plot_2D_pdf.R does with the raw counts
+//   PerColumn  each x column sums to 1, showing the distribution of y at every x regardless of how many points it holds
+//   PerSeries  each bin is divided by the number of series, giving the expected number of points a series puts there
+
+enum class DensityKernel { None, Gaussian, Epanechnikov };
+enum class DensityNormalization { Global, PerColumn, PerSeries };
+
+struct DensityOptions
+{
+  DensityKernel kernel;
+  double xBandwidth;    // in bins
+  double yBandwidth;    // in bins
+  DensityNormalization normalization;
+
+  DensityOptions(DensityKernel kernel = DensityKernel::Gaussian, double xBandwidth = 1, double yBandwidth = 1,
+		 DensityNormalization normalization = DensityNormalization::Global)
+    : kernel(kernel), xBandwidth(xBandwidth), yBandwidth(yBandwidth), normalization(normalization) {}
+};
+
+// A normalized density over the bins of a histogram
+struct DensityGrid
+{
+  int xBins = 0;
+  int yBins = 0;
+  std::vector<double> xEdges;
+  std::vector<double> yEdges;
+  double total = 0;             // sum of the raw counts the density was made from
+  std::vector<float> values;    // row by row with y as the row, the same order Hist2D::print uses
+
+  float at(int yBin, int xBin) const { return values[(std::size_t) yBin * xBins + xBin]; }
+};
+
+class HistDensity
+{
+ public:
+  // Kernel weights are worked out once here and shared by every histogram passed to compute()
+  explicit HistDensity(const DensityOptions& options = DensityOptions())
+    : m_options(options), m_xTaps(taps(options.kernel, options.xBandwidth)), m_yTaps(taps(options.kernel, options.yBandwidth))
+  {}
+
+  // Density of hist. seriesCount, the number of series added to hist, is needed only for PerSeries normalization,
+  // which throws std::invalid_argument without it. Safe to call from several threads at once.
+  template <typename T, typename CountT>
+  DensityGrid compute(const Hist2D<T, CountT>& hist, double seriesCount = 0) const {
+    if ( m_options.normalization == DensityNormalization::PerSeries && !(seriesCount > 0) ) {
+      throw std::invalid_argument("HistDensity PerSeries normalization needs the number of series");
+    }
+    DensityGrid grid;
+    grid.xBins  = hist.getXBins();
+    grid.yBins  = hist.getYBins();
+    grid.xEdges = hist.getXEdges();
+    grid.yEdges = hist.getYEdges();
+    std::size_t xBins = grid.xBins, yBins = grid.yBins;
+    grid.values.resize(xBins * yBins);
+    for ( std::size_t y = 0; y < yBins; y++ ) {
+      for ( std::size_t x = 0; x < xBins; x++ ) {
+	double count = (double) hist.getCount(y, x);
+	grid.total += count;
+	grid.values[y * xBins + x] = (float) count;
+      }
+    }
+    std::vector<float> scratch(grid.values.size());
+    if ( m_xTaps.size() > 1 ) {
+      smoothRows(grid.values.data(), scratch.data(), xBins, yBins);
+      grid.values.swap(scratch);
+    }
+    if ( m_yTaps.size() > 1 ) {
+      smoothColumns(grid.values.data(), scratch.data(), xBins, yBins);
+      grid.values.swap(scratch);
+    }
+    normalize(grid.values.data(), xBins, yBins, seriesCount);
+    return grid;
+  }
+
+ private:
+  DensityOptions m_options;
+  std::vector<float> m_xTaps;   // kernel weights for offsets -r..r along x
+  std::vector<float> m_yTaps;
+
+  static std::vector<float> taps(DensityKernel kernel, double bandwidth) {
+    std::vector<float> weights(1, 1.0f);
+    if ( kernel == DensityKernel::None || !(bandwidth > 0) ) return weights;
+    int radius = kernel == DensityKernel::Gaussian ? (int) std::ceil(3 * bandwidth) : (int) std::ceil(bandwidth) - 1;
+    weights.assign(2 * radius + 1, 0.0f);
+    for ( int d = -radius; d <= radius; d++ ) {
+      double u = d / bandwidth;
+      weights[d + radius] = (float) (kernel == DensityKernel::Gaussian ? std::exp(-0.5 * u * u) : 1 - u * u);
+    }
+    return weights;
+  }
+
+  // For each position of an axis of n bins, 1 / the sum of the kernel weights that fall inside the axis
+  static std::vector<float> edgeScale(const std::vector<float>& weights, std::size_t n) {
+    int radius = weights.size() / 2;
+    std::vector<float> scale(n);
+    for ( std::size_t i = 0; i < n; i++ ) {
+      double sum = 0;
+      for ( int d = -radius; d <= radius; d++ ) {
+	long long j = (long long) i + d;
+	if ( j >= 0 && j < (long long) n ) sum += weights[d + radius];
+      }
+      scale[i] = (float) (1 / sum);
+    }
+    return scale;
+  }
+
+  // Smooths along x: each output row is the sum over offsets d of its (edge rescaled) input row shifted by d,
+  // times the weight of d
+  void smoothRows(const float* in, float* out, std::size_t xBins, std::size_t yBins) const {
+    int radius = m_xTaps.size() / 2;
+    std::vector<float> scale = edgeScale(m_xTaps, xBins);
+    std::vector<float> row(xBins);
+    std::fill(out, out + xBins * yBins, 0.0f);
+    for ( std::size_t y = 0; y < yBins; y++ ) {
+      std::copy(in + y * xBins, in + (y + 1) * xBins, row.begin());
+      multiply(row.data(), scale.data(), xBins);
+      float* target = out + y * xBins;
+      for ( int d = -radius; d <= radius; d++ ) {
+	std::size_t low  = std::max<long long>(0, -d);
+	std::size_t high = std::min<long long>(xBins, (long long) xBins - d);
+	if ( low < high ) addScaled(target + low, row.data() + low + d, m_xTaps[d + radius], high - low);
+      }
+    }
+  }
+
+  // Smooths along y: each output row is the sum of the input rows around it, times their weights and edge scales
+  void smoothColumns(const float* in, float* out, std::size_t xBins, std::size_t yBins) const {
+    int radius = m_yTaps.size() / 2;
+    std::vector<float> scale = edgeScale(m_yTaps, yBins);
+    std::fill(out, out + xBins * yBins, 0.0f);
+    for ( std::size_t y = 0; y < yBins; y++ ) {
+      float* target = out + y * xBins;
+      for ( int d = -radius; d <= radius; d++ ) {
+	long long source = (long long) y + d;
+	if ( source < 0 || source >= (long long) yBins ) continue;
+	addScaled(target, in + source * xBins, m_yTaps[d + radius] * scale[source], xBins);
+      }
+    }
+  }
+
+  void normalize(float* values, std::size_t xBins, std::size_t yBins, double seriesCount) const {
+    switch ( m_options.normalization ) {
+    case DensityNormalization::Global: {
+      double sum = 0;
+      for ( std::size_t i = 0; i < xBins * yBins; i++ ) sum += values[i];
+      if ( sum > 0 ) scaleBy(values, (float) (1 / sum), xBins * yBins);
+      break;
+    }
+    case DensityNormalization::PerColumn: {
+      std::vector<double> sums(xBins, 0.0);
+      for ( std::size_t y = 0; y < yBins; y++ ) {
+	for ( std::size_t x = 0; x < xBins; x++ ) sums[x] += values[y * xBins + x];
+      }
+      std::vector<float> inverse(xBins);
+      for ( std::size_t x = 0; x < xBins; x++ ) inverse[x] = sums[x] > 0 ? (float) (1 / sums[x]) : 0.0f;
+      for ( std::size_t y = 0; y < yBins; y++ ) multiply(values + y * xBins, inverse.data(), xBins);
+      break;
+    }
+    case DensityNormalization::PerSeries:
+      scaleBy(values, (float) (1 / seriesCount), xBins * yBins);
+      break;
+    }
+  }
+
+  // out[i] += weight * in[i]
+  static void addScaled(float* out, const float* in, float weight, std::size_t n) {
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    __m256 w = _mm256_set1_ps(weight);
+    for ( ; i + 8 <= n; i += 8 ) {
+      _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(w, _mm256_loadu_ps(in + i))));
+    }
+#endif
+    for ( ; i < n; i++ ) out[i] += weight * in[i];
+  }
+
+  // values[i] *= factors[i]
+  static void multiply(float* values, const float* factors, std::size_t n) {
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    for ( ; i + 8 <= n; i += 8 ) {
+      _mm256_storeu_ps(values + i, _mm256_mul_ps(_mm256_loadu_ps(values + i), _mm256_loadu_ps(factors + i)));
+    }
+#endif
+    for ( ; i < n; i++ ) values[i] *= factors[i];
+  }
+
+  // values[i] *= factor
+  static void scaleBy(float* values, float factor, std::size_t n) {
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    __m256 f = _mm256_set1_ps(factor);
+    for ( ; i + 8 <= n; i += 8 ) _mm256_storeu_ps(values + i, _mm256_mul_ps(_mm256_loadu_ps(values + i), f));
+#endif
+    for ( ; i < n; i++ ) values[i] *= factor;
+  }
+};
+
+// Densities of all groups of a GroupAggregator, indexed by group id. Groups are shared out among threads.
+template <typename Aggregator>
+std::vector<DensityGrid> groupDensities(const Aggregator& groups, const DensityOptions& options = DensityOptions(),
+					unsigned int threads = std::thread::hardware_concurrency())
+{
+  HistDensity engine(options);
+  std::size_t count = groups.getGroups().size();
+  std::vector<DensityGrid> result(count);
+  std::atomic<std::size_t> next(0);
+  auto work = [&] {
+    for ( std::size_t id = next++; id < count; id = next++ ) {
+      result[id] = engine.compute(groups.getHistogram(id), (double) groups.getSeriesCount(id));
+    }
+  };
+  if ( threads <= 1 || count <= 1 ) {
+    work();
+  } else {
+    std::vector<std::thread> workers;
+    for ( unsigned int t = 0; t < std::min<std::size_t>(threads, count); t++ ) workers.push_back(std::thread(work));
+    for ( auto& worker: workers ) worker.join();
+  }
+  return result;
+}
+
+// Saves the density of each group to <outputDir><group><histComponent>.h2d (see BinaryOutput.h).
+// Returns false if any file could not be written.
+template <typename Aggregator>
+bool writeDensities(const Aggregator& groups, const std::string& outputDir, const std::string& histComponent,
+		    const DensityOptions& options = DensityOptions(), unsigned int threads = std::thread::hardware_concurrency())
+{
+  std::vector<DensityGrid> densities = groupDensities(groups, options, threads);
+  INSTRUMENT_SCOPE(Write);
+  bool written = true;
+  for ( std::size_t id = 0; id < densities.size(); id++ ) {
+    written &= writeDensity(outputDir + groups.getGroups().key(id) + histComponent + ".h2d", densities[id]);
+  }
+  return written;
+}
+
+#endif // HIST_DENSITY
@@ -0,0 +1,288 @@
+#ifndef HIST_DISTANCE
+#define HIST_DISTANCE
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "Hist2D.h"
+
+// HistDistances compares histograms with the same bin layout, such as the per-group histograms of a
+// GroupAggregator, to cluster groups by the shape of their trajectories or find a group's nearest neighbours.
+// Each histogram is normalized once to a probability distribution over its bins and stored in one
+// contiguous row, together with the cumulative distributions of its x and y marginals, so every pairwise
+// distance is a single pass over two rows. All distances are scaled to lie in [0, 1]:
+//   L1             half the sum of absolute differences (total variation distance)
+//   ChiSquare      half the sum of (p - q)^2 / (p + q) over bins where either is non-zero
+//   JensenShannon  Jensen-Shannon divergence with base 2 logarithms
+//   EarthMover     mean of the 1D earth mover's distances of the x and y marginals, each in units of
+//                  the full axis length; an approximation of the 2D earth mover's distance
+// Empty histograms are treated as all-zero rows.
+
+enum class HistMetric { L1, ChiSquare, JensenShannon, EarthMover };
+
+// A symmetric n x n matrix of distances between named histograms, stored row by row
+struct DistanceMatrix
+{
+  std::vector<std::string> names;
+  std::vector<double> values;
+
+  std::size_t size() const { return names.size(); }
+  double at(std::size_t i, std::size_t j) const { return values[i * names.size() + j]; }
+
+  // Indices of the k histograms closest to histogram i, nearest first, excluding i itself
+  std::vector<std::size_t> nearest(std::size_t i, std::size_t k) const {
+    std::vector<std::size_t> order;
+    for ( std::size_t j = 0; j < size(); j++ ) if ( j != i ) order.push_back(j);
+    k = std::min(k, order.size());
+    std::partial_sort(order.begin(), order.begin() + k, order.end(),
+		      [&](std::size_t a, std::size_t b) { return at(i, a) < at(i, b); });
+    order.resize(k);
+    return order;
+  }
+};
+
+class HistDistances
+{
+ public:
+  // Normalizes hists, which must all share one bin layout, otherwise std::invalid_argument is thrown
+  template <typename T, typename CountT>
+  HistDistances(const std::vector<const Hist2D<T, CountT>*>& hists, const std::vector<std::string>& names)
+    : m_names(names), m_count(hists.size()), m_xBins(0), m_yBins(0)
+  {
+    if ( names.size() != hists.size() ) throw std::invalid_argument("HistDistances needs one name per histogram");
+    if ( hists.empty() ) return;
+    m_xBins = hists[0]->getXBins();
+    m_yBins = hists[0]->getYBins();
+    m_cells = (std::size_t) m_xBins * m_yBins;
+    m_cdfSize = (m_xBins - 1) + (m_yBins - 1);
+    m_mass.resize(m_count * m_cells);
+    m_cdf.resize(m_count * m_cdfSize);
+    m_entropy.resize(m_count);
+    for ( std::size_t h = 0; h < m_count; h++ ) {
+      if ( !hists[h]->sameLayout(*hists[0]) ) {
+	throw std::invalid_argument("HistDistances requires histograms with identical bin layouts");
+      }
+      normalize(*hists[h], &m_mass[h * m_cells], &m_cdf[h * m_cdfSize]);
+      m_entropy[h] = entropy(&m_mass[h * m_cells], m_cells);
+    }
+  }
+
+  std::size_t size() const { return m_count; }
+
+  // Distance between histograms i and j
+  double distance(std::size_t i, std::size_t j, HistMetric metric) const {
+    return rowDistance(&m_mass[i * m_cells], &m_cdf[i * m_cdfSize], m_entropy[i],
+		       &m_mass[j * m_cells], &m_cdf[j * m_cdfSize], m_entropy[j], metric);
+  }
+
+  // Distances between all pairs, computed over square blocks of the pair matrix shared out among threads.
+  // Blocks keep the rows being compared in cache while each is reused against a whole block of others.
+  DistanceMatrix all(HistMetric metric, unsigned int threads = std::thread::hardware_concurrency()) const {
+    DistanceMatrix result;
+    result.names = m_names;
+    result.values.assign(m_count * m_count, 0.0);
+    std::size_t blocks = (m_count + BLOCK - 1) / BLOCK;
+    // Blocks on and above the diagonal, numbered row by row
+    std::size_t blockPairs = blocks * (blocks + 1) / 2;
+    std::atomic<std::size_t> next(0);
+
+    auto work = [&] {
+      for ( std::size_t pair = next++; pair < blockPairs; pair = next++ ) {
+	std::size_t bi = 0, rowLength = blocks;
+	std::size_t index = pair;
+	while ( index >= rowLength ) { index -= rowLength; bi++; rowLength--; }
+	std::size_t bj = bi + index;
+	for ( std::size_t i = bi * BLOCK; i < std::min(m_count, (bi + 1) * BLOCK); i++ ) {
+	  for ( std::size_t j = std::max(i + 1, bj * BLOCK); j < std::min(m_count, (bj + 1) * BLOCK); j++ ) {
+	    double d = distance(i, j, metric);
+	    result.values[i * m_count + j] = d;
+	    result.values[j * m_count + i] = d;
+	  }
+	}
+      }
+    };
+
+    if ( threads <= 1 || blockPairs <= 1 ) {
+      work();
+    } else {
+      std::vector<std::thread> workers;
+      for ( unsigned int t = 0; t < threads; t++ ) workers.push_back(std::thread(work));
+      for ( auto& worker: workers ) worker.join();
+    }
+    return result;
+  }
+
+  // Distances from a histogram outside the set (with the same layout) to every histogram in the set
+  template <typename T, typename CountT>
+  std::vector<double> to(const Hist2D<T, CountT>& query, HistMetric metric) const {
+    std::vector<double> mass(m_cells), cdf(m_cdfSize), result(m_count);
+    normalize(query, mass.data(), cdf.data());
+    double queryEntropy = entropy(mass.data(), m_cells);
+    for ( std::size_t h = 0; h < m_count; h++ ) {
+      result[h] = rowDistance(mass.data(), cdf.data(), queryEntropy,
+			      &m_mass[h * m_cells], &m_cdf[h * m_cdfSize], m_entropy[h], metric);
+    }
+    return result;
+  }
+
+ private:
+  static const std::size_t BLOCK = 32;
+
+  std::vector<std::string> m_names;
+  std::size_t m_count;
+  int m_xBins;
+  int m_yBins;
+  std::size_t m_cells = 0;
+  std::size_t m_cdfSize = 0;
+  std::vector<double> m_mass;   // normalized counts, m_cells per histogram, row y then column x
+  std::vector<double> m_cdf;    // x marginal CDF (xBins - 1 values) then y marginal CDF (yBins - 1 values)
+  std::vector<double> m_entropy; // entropy of each normalized histogram, in bits
+
+  template <typename T, typename CountT>
+  void normalize(const Hist2D<T, CountT>& hist, double* mass, double* cdf) const {
+    double total = 0;
+    for ( int y = 0; y < m_yBins; y++ ) {
+      for ( int x = 0; x < m_xBins; x++ ) {
+	mass[(std::size_t) y * m_xBins + x] = (double) hist.getCount(y, x);
+	total += mass[(std::size_t) y * m_xBins + x];
+      }
+    }
+    if ( total > 0 ) {
+      for ( std::size_t c = 0; c < m_cells; c++ ) mass[c] /= total;
+    }
+    // The last value of each CDF is always 1 (or 0), so it is left out
+    std::vector<double> xMarginal(m_xBins, 0.0), yMarginal(m_yBins, 0.0);
+    for ( int y = 0; y < m_yBins; y++ ) {
+      for ( int x = 0; x < m_xBins; x++ ) {
+	xMarginal[x] += mass[(std::size_t) y * m_xBins + x];
+	yMarginal[y] += mass[(std::size_t) y * m_xBins + x];
+      }
+    }
+    std::partial_sum(xMarginal.begin(), xMarginal.end() - 1, cdf);
+    std::partial_sum(yMarginal.begin(), yMarginal.end() - 1, cdf + (m_xBins - 1));
+  }
+
+  double rowDistance(const double* p, const double* pCdf, double pEntropy,
+		     const double* q, const double* qCdf, double qEntropy, HistMetric metric) const {
+    switch ( metric ) {
+    case HistMetric::L1:
+      return 0.5 * absDifference(p, q, m_cells);
+    case HistMetric::ChiSquare:
+      return 0.5 * chiSquare(p, q, m_cells);
+    case HistMetric::JensenShannon:
+      return jensenShannon(p, q, m_cells, pEntropy, qEntropy);
+    case HistMetric::EarthMover: {
+      double x = m_xBins > 1 ? absDifference(pCdf, qCdf, m_xBins - 1) / (m_xBins - 1) : 0.0;
+      double y = m_yBins > 1 ? absDifference(pCdf + (m_xBins - 1), qCdf + (m_xBins - 1), m_yBins - 1) / (m_yBins - 1) : 0.0;
+      return 0.5 * (x + y);
+    }
+    }
+    return 0;
+  }
+
+  // Sum of |p[i] - q[i]|
+  static double absDifference(const double* p, const double* q, std::size_t n) {
+    std::size_t i = 0;
+    double sum = 0;
+#if defined(__AVX2__)
+    __m256d acc = _mm256_setzero_pd();
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    for ( ; i + 4 <= n; i += 4 ) {
+      __m256d d = _mm256_sub_pd(_mm256_loadu_pd(p + i), _mm256_loadu_pd(q + i));
+      acc = _mm256_add_pd(acc, _mm256_andnot_pd(signMask, d));
+    }
+    sum = horizontalSum(acc);
+#endif
+    for ( ; i < n; i++ ) sum += std::fabs(p[i] - q[i]);
+    return sum;
+  }
+
+  // Sum of (p[i] - q[i])^2 / (p[i] + q[i]) over the bins where p[i] + q[i] > 0
+  static double chiSquare(const double* p, const double* q, std::size_t n) {
+    std::size_t i = 0;
+    double sum = 0;
+#if defined(__AVX2__)
+    __m256d acc = _mm256_setzero_pd();
+    const __m256d zero = _mm256_setzero_pd();
+    for ( ; i + 4 <= n; i += 4 ) {
+      __m256d a = _mm256_loadu_pd(p + i), b = _mm256_loadu_pd(q + i);
+      __m256d d = _mm256_sub_pd(a, b), s = _mm256_add_pd(a, b);
+      __m256d nonEmpty = _mm256_cmp_pd(s, zero, _CMP_GT_OQ);
+      // Empty bins divide 0 by 1 instead of by 0
+      __m256d denominator = _mm256_blendv_pd(_mm256_set1_pd(1.0), s, nonEmpty);
+      acc = _mm256_add_pd(acc, _mm256_div_pd(_mm256_mul_pd(d, d), denominator));
+    }
+    sum = horizontalSum(acc);
+#endif
+    for ( ; i < n; i++ ) {
+      double s = p[i] + q[i];
+      if ( s > 0 ) sum += (p[i] - q[i]) * (p[i] - q[i]) / s;
+    }
+    return sum;
+  }
+
+  // Entropy in bits, -sum p log2 p
+  static double entropy(const double* p, std::size_t n) {
+    double sum = 0;
+    for ( std::size_t i = 0; i < n; i++ ) {
+      if ( p[i] > 0 ) sum -= p[i] * std::log2(p[i]);
+    }
+    return sum;
+  }
+
+  // H((p + q) / 2) - (H(p) + H(q)) / 2, which needs one logarithm per non-empty bin given the entropies of p and q.
+  // Bins are taken a block at a time: a branchless pass packs the non-zero mixture values into a buffer on the
+  // stack (the write is unconditional, only the count moves), then a second pass takes their logarithms with no
+  // test per bin. Histograms of short series are mostly empty, so this skips most of the logarithms without the
+  // mispredicted branch per bin of a single loop. The logarithms are libm calls, so the result is exactly that of
+  // the single loop, terms being added in the same order.
+  static double jensenShannon(const double* p, const double* q, std::size_t n, double pEntropy, double qEntropy) {
+    const std::size_t CHUNK = 256;
+    double nonZero[CHUNK];
+    double mixed = 0;
+    for ( std::size_t begin = 0; begin < n; begin += CHUNK ) {
+      std::size_t end = std::min(n, begin + CHUNK);
+      std::size_t count = 0;
+      for ( std::size_t i = begin; i < end; i++ ) {
+	double m = 0.5 * (p[i] + q[i]);
+	nonZero[count] = m;
+	count += (m > 0);
+      }
+      for ( std::size_t k = 0; k < count; k++ ) mixed -= nonZero[k] * std::log2(nonZero[k]);
+    }
+    return std::min(1.0, std::max(0.0, mixed - 0.5 * (pEntropy + qEntropy)));
+  }
+
+#if defined(__AVX2__)
+  static double horizontalSum(__m256d v) {
+    __m128d low = _mm256_castpd256_pd128(v), high = _mm256_extractf128_pd(v, 1);
+    low = _mm_add_pd(low, high);
+    return _mm_cvtsd_f64(_mm_add_sd(low, _mm_unpackhi_pd(low, low)));
+  }
+#endif
+};
+
+// Distance matrix between all groups of a GroupAggregator
+template <typename Aggregator>
+DistanceMatrix groupDistances(const Aggregator& groups, HistMetric metric,
+			      unsigned int threads = std::thread::hardware_concurrency())
+{
+  std::vector<const typename std::decay<decltype(groups.getHistogram(0))>::type*> hists;
+  std::vector<std::string> names;
+  for ( std::size_t id = 0; id < groups.getGroups().size(); id++ ) {
+    hists.push_back(&groups.getHistogram(id));
+    names.push_back(groups.getGroups().key(id));
+  }
+  return HistDistances(hists, names).all(metric, threads);
+}
+
+#endif // HIST_DISTANCE
@@ -7,6 +7,8 @@
 #include <algorithm>
 #include <cmath>
 
+#include "SeriesStats.h"
+
 // NumericVector is designed to hold one-dimensional series. For example, it can hold time series, value vs. distance, paired data where the x-values are numerically related to one another,  etc. 
 // NumericVector is best used to hold data that will be fully loaded before any analysis is done. This facilitates lazy computation of relevant statistics. 
 // NumericVector can be templated to any arithmetic type.  
@@ -22,7 +24,7 @@ template <typename T,
   int length;
 
   //Default constructor
-  NumericVector() {}
+  NumericVector() : m_maxY(0), m_minY(0), m_maxX(0), m_minX(0), length(0) {}
   
   // NumericVector requires two std::vectors of type T for allocation and initialization.
   // Some relevant attributes of the two vectors are immediately computed upon class initialization
@@ -36,6 +38,33 @@ template <typename T,
     length   = m_yAxis.size();
   }
 
+  // Appends the values of another series to the end of this one in place.
+  // Extremes are updated from the appended values only, and lazily computed
+  // statistics (sorted, unique, inflections) are marked stale rather than recomputed,
+  // so appending costs time proportional to the appended series alone.
+  void append(const NumericVector<T>& other) {
+    append(other.m_yAxis, other.m_xAxis);
+  }
+
+  void append(const std::vector<T>& newY, const std::vector<T>& newX) {
+    if ( newY.empty() ) return;
+    auto yRange = std::minmax_element(newY.begin(), newY.end());
+    auto xRange = std::minmax_element(newX.begin(), newX.end());
+    if ( m_yAxis.empty() ) {
+      m_minY = *yRange.first;  m_maxY = *yRange.second;
+      m_minX = *xRange.first;  m_maxX = *xRange.second;
+    } else {
+      m_minY = std::min(m_minY, *yRange.first);  m_maxY = std::max(m_maxY, *yRange.second);
+      m_minX = std::min(m_minX, *xRange.first);  m_maxX = std::max(m_maxX, *xRange.second);
+    }
+    m_yAxis.insert(m_yAxis.end(), newY.begin(), newY.end());
+    m_xAxis.insert(m_xAxis.end(), newX.begin(), newX.end());
+    length = m_yAxis.size();
+    m_sortedComputed = false;
+    m_uniqueComputed = false;
+    m_inflectionComputed = false;
+  }
+
   // Retrieves constant references to the x or y vectors stored in NumericVector 
   const std::vector <T>&  getYConst() const { return this->m_yAxis;}
   const std::vector <T>&  getXConst() const { return this->m_xAxis;}
@@ -110,24 +139,12 @@ template <typename T,
   // 0. length of series, 1. min yAxis value, 2. max yAxis value, 3. min xAxis value,
   // 4. max xAxis value, 5. inflection count, 6. number of unique levels,
   // 7. mean of series, 8. sd of series
+  // All but the unique count come from a single fused pass over the series (see SeriesStats.h)
   const std::vector<double> getAllData(){   // Note that doubles are used regardless of templating type, and code does not safeguard against potential casting errors (e.g. going from long int -> double)
     std::vector<double> result(9);
-    result[0]          = m_yAxis.size();   
-
-    auto min_max_value = std::minmax_element(m_yAxis.begin(), m_yAxis.end());    
-    result[1]          = *(min_max_value.first); 
-    result[2]          = *(min_max_value.second);
-
-    min_max_value      = std::minmax_element(m_xAxis.begin(), m_xAxis.end());
-    result[3]          = *(min_max_value.first);
-    result[4]          = *(min_max_value.second);
-
-    result[5]          = getInflectionCount();
-    result[6]          = getUniqueCount();
-
-    result[7]          = calcMean();
-    result[8]          = calcSD();
-
+    computeSeriesStats(m_yAxis.data(), m_xAxis.data(), m_yAxis.size(), result.data());
+    result[6] = ( m_yAxis.size() <= SMALL_SERIES_LENGTH && !m_uniqueComputed ) ?
+      countUniqueSmall(m_yAxis.data(), m_yAxis.size()) : getUniqueCount();
     return result;
   }
 
@@ -145,7 +162,7 @@ template <typename T,
   std::vector<T> m_uniqueNumbers = { };
   std::vector<T> m_sortedNumbers = { };
   std::vector<T> m_inflection = { };
-  int m_inflectionCount;
+  int m_inflectionCount = 0;
   bool m_uniqueComputed = false;
   bool m_sortedComputed = false;
   bool m_inflectionComputed = false;
@@ -159,10 +176,44 @@ template <typename T,
   }
 
 
+  // Integer series whose values span at most this many levels are sorted by counting
+  // rather than by comparison, e.g. ranks in [0, 25] or hours in [0, 23]
+  static const long long MAX_COUNTING_DOMAIN = 1 << 16;
+
+  // True when the y values are integers drawn from a domain small enough, relative to the
+  // length of the series, that a counting table beats std::sort. The domain is taken from
+  // m_minY/m_maxY, which are kept current by the constructor and append().
+  bool useCounting() const {
+    if ( !std::is_integral<T>::value || m_yAxis.empty() ) return false;
+    long long domain = (long long) m_maxY - (long long) m_minY + 1;
+    return domain <= MAX_COUNTING_DOMAIN && domain <= 8 * (long long) m_yAxis.size() + 1024;
+  }
+
+  // Counts how often each level of the domain occurs, in a table reused across calls and series
+  const std::vector<unsigned int>& countLevels() const {
+    static thread_local std::vector<unsigned int> counts;
+    counts.assign((long long) m_maxY - (long long) m_minY + 1, 0);
+    for ( auto it = m_yAxis.begin(); it != m_yAxis.end(); ++it ) {
+      counts[(long long) *it - (long long) m_minY] += 1;
+    }
+    return counts;
+  }
+
   // Computes ordered vector of all yAxis values
+  // O(n + domain) by counting for small integer domains, otherwise a copy and std::sort
   void computeSorted() {   
+    if ( useCounting() ) {
+      const std::vector<unsigned int>& counts = countLevels();
+      m_sortedNumbers.clear();
+      m_sortedNumbers.reserve(m_yAxis.size());
+      for ( std::size_t level = 0; level < counts.size(); level++ ) {
+	m_sortedNumbers.insert(m_sortedNumbers.end(), counts[level], (T) (m_minY + level));
+      }
+    } else {
       m_sortedNumbers.assign(m_yAxis.begin(), m_yAxis.end());
       std::sort(m_sortedNumbers.begin(), m_sortedNumbers.end());
+    }
+    m_sortedComputed = true;
   }
 
   
@@ -170,13 +221,25 @@ template <typename T,
   // No precautionary steps are taken to deal with numeric error
   // so this method should robably be restructed to int types
   // but such restriction is not forced in the code
+  // For small integer domains the unique values are read straight off the counting table,
+  // without building the sorted copy at all
   void computeUnique(bool useDefault = true){   
+    if ( useCounting() && !m_sortedComputed ) {
+      const std::vector<unsigned int>& counts = countLevels();
+      m_uniqueNumbers.clear();
+      for ( std::size_t level = 0; level < counts.size(); level++ ) {
+	if ( counts[level] ) m_uniqueNumbers.push_back((T) (m_minY + level));
+      }
+      m_uniqueComputed = true;
+      return;
+    }
     if ( !m_sortedComputed ) {
       computeSorted();
     }
     m_uniqueNumbers.assign(m_sortedNumbers.begin(), m_sortedNumbers.end());
     auto new_end = std::unique(m_uniqueNumbers.begin(), m_uniqueNumbers.end());
     m_uniqueNumbers.erase(new_end, m_uniqueNumbers.end());
+    m_uniqueComputed = true;
   }
 
   // Calculates the mean of m_yAxis if useDefault is true
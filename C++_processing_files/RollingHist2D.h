@@ -0,0 +1,127 @@
+#ifndef ROLLING_HIST_2D
+#define ROLLING_HIST_2D
+
+#include <vector>
+#include <ostream>
+
+#include "Hist2D.h"
+
+// RollingHist2D is a Hist2D over a sliding time window, e.g. the last 7 days of scrapes updated hourly.
+// Time is cut into slices of slide units (seconds, hours, ... whatever the caller's timestamps use),
+// and the window is the newest window/slide slices. Each slice keeps its own Hist2D in a ring buffer,
+// and a running total holds the sum of the slices in the window. When time moves past the newest slice,
+// each slice that falls out of the window is subtracted from the total and cleared for reuse, so moving
+// the window costs one pass over the bins of the expired slices rather than a rebuild from the input.
+// Every series is counted in the slice of the timestamp it is added with, such as its created time
+// or the time of its latest observation.
+template <typename T, typename CountT = T>
+class RollingHist2D : public Hist2DAlignment
+{
+ public:
+  typedef Hist2D<T, CountT> hist_type;
+
+  // window must be a positive multiple of slide
+  RollingHist2D(long long window, long long slide, int xBins = 26, int yBins = 28,
+		double xMin = -.1, double xMax = 24, double yMin = -.1, double yMax = 25.1)
+    : m_slide(slide), m_total(xBins, yBins, xMin, xMax, yMin, yMax)
+  {
+    init(window);
+  }
+
+  RollingHist2D(long long window, long long slide, const std::vector<double>& xEdges, const std::vector<double>& yEdges)
+    : m_slide(slide), m_total(xEdges, yEdges)
+  {
+    init(window);
+  }
+
+  // Adds a series observed at time to its slice and to the window.
+  // Times newer than the window move it forward first. Returns false, adding nothing,
+  // if time falls before the start of the current window.
+  template <typename Series>
+  bool addToHist(long long time, const Series& series, Alignment alignment, CountT weight = 1) {
+    long long slice = sliceOf(time);
+    if ( m_empty || slice > m_newest ) advanceTo(time);
+    if ( slice <= m_newest - slices() ) return false;
+    m_slices[slot(slice)].addToHist(series, alignment, weight);
+    m_total.addToHist(series, alignment, weight);
+    return true;
+  }
+
+  // Moves the window forward so that it ends with the slice holding time, expiring older slices.
+  // Moving backwards has no effect.
+  void advanceTo(long long time) {
+    long long slice = sliceOf(time);
+    if ( m_empty ) {
+      m_newest = slice;
+      m_empty = false;
+      return;
+    }
+    if ( slice <= m_newest ) return;
+    if ( slice - m_newest >= slices() ) {
+      // The whole window expires at once
+      for ( auto& s: m_slices ) s.clear();
+      m_total.clear();
+    } else {
+      for ( long long expired = m_newest - slices() + 1; expired <= slice - slices(); expired++ ) {
+	hist_type& old = m_slices[slot(expired)];
+	m_total.subtract(old);
+	old.clear();
+      }
+    }
+    m_newest = slice;
+  }
+
+  // The histogram of everything in the current window
+  const hist_type& window() const { return m_total; }
+  // The histogram of the single slice holding time, which must lie within the current window
+  const hist_type& slice(long long time) const { return m_slices[slot(sliceOf(time))]; }
+
+  // Start (inclusive) and end (exclusive) of the current window, in the caller's time units
+  long long windowStart() const { return (m_newest - slices() + 1) * m_slide; }
+  long long windowEnd() const { return (m_newest + 1) * m_slide; }
+  long long slices() const { return m_slices.size(); }
+
+  // Same read interface as Hist2D, for the current window
+  const std::vector<double>& getXEdges() const { return m_total.getXEdges(); }
+  const std::vector<double>& getYEdges() const { return m_total.getYEdges(); }
+  int getXBins() const { return m_total.getXBins(); }
+  int getYBins() const { return m_total.getYBins(); }
+  typename hist_type::total_type getCount(int yBin, int xBin) const { return m_total.getCount(yBin, xBin); }
+  void print(std::ostream& os) const { m_total.print(os); }
+
+  void setWidenOnOverflow(bool widen) {
+    m_total.setWidenOnOverflow(widen);
+    for ( auto& s: m_slices ) s.setWidenOnOverflow(widen);
+  }
+
+  void setOutOfRangeMode(OutOfRangeMode mode) {
+    m_total.setOutOfRangeMode(mode);
+    for ( auto& s: m_slices ) s.setOutOfRangeMode(mode);
+  }
+
+ private:
+  long long m_slide;
+  hist_type m_total;
+  std::vector<hist_type> m_slices;   // slice k lives in m_slices[k mod slices()]
+  long long m_newest = 0;            // index of the newest slice in the window
+  bool m_empty = true;               // nothing has been added yet, so the window has no position
+
+  void init(long long window) {
+    if ( m_slide <= 0 || window < m_slide || window % m_slide != 0 ) {
+      throw std::invalid_argument("RollingHist2D window must be a positive multiple of its slide");
+    }
+    m_slices.assign(window / m_slide, m_total);
+  }
+
+  long long sliceOf(long long time) const {
+    long long q = time / m_slide;
+    return q - ((time % m_slide != 0) & (time < 0));
+  }
+
+  std::size_t slot(long long slice) const {
+    long long s = slice % slices();
+    return s < 0 ? s + slices() : s;
+  }
+};
+
+#endif // ROLLING_HIST_2D
@@ -0,0 +1,490 @@
+#ifndef SERIES_INDEX
+#define SERIES_INDEX
+
+#include <string>
+#include <vector>
+#include <limits>
+#include <numeric>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "FlatVectorOfNumericVectors.h"
+#include "GroupIndex.h"
+#include "BinaryOutput.h"
+#include "Hist2D.h"
+
+// A SeriesIndex is a file holding every parsed series of a scrape once, laid out for fast repeated queries:
+// a question such as "Front alignment for pics, created in July, at least 3 ranks long" becomes a scan over
+// the matching part of a memory-mapped file instead of a fresh parse of the whole TSV.
+//
+// SeriesIndexWriter collects the series and writes the file; SeriesIndex maps it and answers SeriesQuery's.
+// In the file, series are sorted by created time and stored column by column (created, group, point offsets,
+// the extremes of y and x, then all y values and all x values end to end, as in FlatVectorOfNumericVectors).
+// Series are cut into blocks of SERIES_INDEX_BLOCK, and each block has a zone map of the min and max of its
+// created times, lengths, max y and min y, so blocks that cannot match a query are skipped without touching
+// their series. Each group has a posting list of its series ids, also in created order.
+// A query first narrows the series to its created range by binary search, then scans either the whole range
+// block by block or, when it names groups, only the posting lists of those groups.
+//
+// File layout, little-endian, each section starting on an 8 byte boundary:
+//   char[4]  magic "H2DI"
+//   uint32   format version (SERIES_INDEX_VERSION)
+//   uint32   bytes per value of T, then 0 for integer T or 1 for floating point T
+//   uint64   number of series n, number of points p
+//   uint32   block size, number of groups g
+//   int64    created [n]
+//   uint32   group id [n]
+//   uint64   point offsets [n + 1]; series i holds points [offsets[i], offsets[i+1])
+//   T        max y [n], min y [n], max x [n], min x [n]
+//   T        y [p], x [p]
+//   Zone     zone maps [(n + block size - 1) / block size]
+//   uint64   posting offsets [g + 1]; group k holds postings [offsets[k], offsets[k+1])
+//   uint32   postings [n]
+//   uint64   group name offsets [g + 1], then the group names end to end
+// The sections are used in place, so an index can only be opened on a little-endian host.
+
+const std::uint32_t SERIES_INDEX_VERSION = 1;
+const std::uint32_t SERIES_INDEX_BLOCK = 1024;
+
+// Zone map of one block of series
+struct SeriesIndexZone
+{
+  std::int64_t createdMin;
+  std::int64_t createdMax;
+  std::int32_t lengthMin;
+  std::int32_t lengthMax;
+  double maxYMin;
+  double maxYMax;
+  double minYMin;
+  double minYMax;
+};
+
+static_assert(sizeof(SeriesIndexZone) == 56, "SeriesIndexZone must have no padding, it is mapped straight from the file");
+
+// Filter for SeriesIndex queries. Every condition defaults to accepting everything, and the setters chain:
+//   SeriesQuery().group("pics").createdBetween(july, august).lengthBetween(3, 1000)
+struct SeriesQuery
+{
+  std::vector<std::string> groups;    // empty for all groups
+  long long createdFrom = std::numeric_limits<long long>::min();   // created in [createdFrom, createdTo)
+  long long createdTo   = std::numeric_limits<long long>::max();
+  int lengthMin = 0;                  // length in [lengthMin, lengthMax]
+  int lengthMax = std::numeric_limits<int>::max();
+  double maxYMin = -std::numeric_limits<double>::infinity();   // largest y of the series in [maxYMin, maxYMax]
+  double maxYMax = std::numeric_limits<double>::infinity();
+  double minYMin = -std::numeric_limits<double>::infinity();   // smallest y of the series in [minYMin, minYMax]
+  double minYMax = std::numeric_limits<double>::infinity();
+
+  SeriesQuery& group(const std::string& key) { groups.push_back(key); return *this; }
+  SeriesQuery& createdBetween(long long from, long long to) { createdFrom = from; createdTo = to; return *this; }
+  SeriesQuery& lengthBetween(int low, int high) { lengthMin = low; lengthMax = high; return *this; }
+  SeriesQuery& maxYBetween(double low, double high) { maxYMin = low; maxYMax = high; return *this; }
+  SeriesQuery& minYBetween(double low, double high) { minYMin = low; minYMax = high; return *this; }
+};
+
+// Collects series in memory and writes them out as a SeriesIndex file
+template <typename T>
+class SeriesIndexWriter
+{
+  static_assert(sizeof(T) == 4 || sizeof(T) == 8, "SeriesIndex stores 4 or 8 byte values");
+
+ public:
+  void add(const FieldView& key, long long created, const T* y, const T* x, int n) {
+    if ( n <= 0 ) return;
+    m_groupIds.push_back(m_groups.intern(key));
+    m_created.push_back(created);
+    m_series.AddToVector(y, x, n);
+  }
+
+  void add(const std::string& key, long long created, const std::vector<T>& y, const std::vector<T>& x) {
+    add(FieldView(key.data(), key.size()), created, y.data(), x.data(), y.size());
+  }
+
+  std::size_t size() const { return m_created.size(); }
+
+  // Writes the index to filename. Returns false if the file could not be written.
+  bool write(const std::string& filename) const {
+    std::size_t n = m_created.size();
+    std::size_t groups = m_groups.size();
+    // Series in created order; ties keep their input order
+    std::vector<std::uint32_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+		     [this](std::uint32_t a, std::uint32_t b) { return m_created[a] < m_created[b]; });
+
+    BinaryBuffer buffer;
+    buffer.reserve(64 + n * (32 + 4 * sizeof(T)) + m_series.points() * 2 * sizeof(T));
+    buffer.putBytes("H2DI", 4);
+    buffer.putU32(SERIES_INDEX_VERSION);
+    buffer.putU32(sizeof(T));
+    buffer.putU32(std::is_integral<T>::value ? 0 : 1);
+    buffer.putU64(n);
+    buffer.putU64(m_series.points());
+    buffer.putU32(SERIES_INDEX_BLOCK);
+    buffer.putU32(groups);
+
+    for ( std::uint32_t i: order ) buffer.putU64((std::uint64_t) m_created[i]);
+    for ( std::uint32_t i: order ) buffer.putU32(m_groupIds[i]);
+    pad(buffer);
+    std::uint64_t offset = 0;
+    buffer.putU64(offset);
+    for ( std::uint32_t i: order ) {
+      offset += m_series[i].length;
+      buffer.putU64(offset);
+    }
+    for ( std::uint32_t i: order ) putValue(buffer, m_series[i].m_maxY);
+    pad(buffer);
+    for ( std::uint32_t i: order ) putValue(buffer, m_series[i].m_minY);
+    pad(buffer);
+    for ( std::uint32_t i: order ) putValue(buffer, m_series[i].m_maxX);
+    pad(buffer);
+    for ( std::uint32_t i: order ) putValue(buffer, m_series[i].m_minX);
+    pad(buffer);
+    for ( std::uint32_t i: order ) {
+      NumericSeriesView<T> series = m_series[i];
+      for ( int j = 0; j < series.length; j++ ) putValue(buffer, series.getYData()[j]);
+    }
+    pad(buffer);
+    for ( std::uint32_t i: order ) {
+      NumericSeriesView<T> series = m_series[i];
+      for ( int j = 0; j < series.length; j++ ) putValue(buffer, series.getXData()[j]);
+    }
+    pad(buffer);
+
+    for ( std::size_t start = 0; start < n; start += SERIES_INDEX_BLOCK ) {
+      SeriesIndexZone zone = zoneOf(order, start, std::min<std::size_t>(n, start + SERIES_INDEX_BLOCK));
+      buffer.putU64((std::uint64_t) zone.createdMin);
+      buffer.putU64((std::uint64_t) zone.createdMax);
+      buffer.putU32((std::uint32_t) zone.lengthMin);
+      buffer.putU32((std::uint32_t) zone.lengthMax);
+      buffer.putDouble(zone.maxYMin);
+      buffer.putDouble(zone.maxYMax);
+      buffer.putDouble(zone.minYMin);
+      buffer.putDouble(zone.minYMax);
+    }
+
+    // Posting lists, built by counting sort over the sorted series so each list stays in created order
+    std::vector<std::uint64_t> postingOffsets(groups + 1, 0);
+    for ( std::uint32_t i: order ) postingOffsets[m_groupIds[i] + 1]++;
+    std::partial_sum(postingOffsets.begin(), postingOffsets.end(), postingOffsets.begin());
+    std::vector<std::uint32_t> postings(n);
+    std::vector<std::uint64_t> next(postingOffsets.begin(), postingOffsets.end() - 1);
+    for ( std::size_t sorted = 0; sorted < n; sorted++ ) postings[next[m_groupIds[order[sorted]]]++] = sorted;
+    for ( std::uint64_t value: postingOffsets ) buffer.putU64(value);
+    for ( std::uint32_t value: postings ) buffer.putU32(value);
+    pad(buffer);
+
+    std::uint64_t nameOffset = 0;
+    buffer.putU64(nameOffset);
+    for ( std::size_t g = 0; g < groups; g++ ) {
+      nameOffset += m_groups.keyView(g).size;
+      buffer.putU64(nameOffset);
+    }
+    for ( std::size_t g = 0; g < groups; g++ ) {
+      FieldView name = m_groups.keyView(g);
+      buffer.putBytes(name.data, name.size);
+    }
+    pad(buffer);
+    return buffer.writeFile(filename);
+  }
+
+ private:
+  GroupIndex m_groups;
+  std::vector<int> m_groupIds;
+  std::vector<long long> m_created;
+  FlatVectorOfNumericVectors<T> m_series;
+
+  static void pad(BinaryBuffer& buffer) {
+    static const char zeros[8] = {};
+    std::size_t size = buffer.bytes().size();
+    if ( size % 8 != 0 ) buffer.putBytes(zeros, 8 - size % 8);
+  }
+
+  static void putValue(BinaryBuffer& buffer, T value) {
+    if ( std::is_integral<T>::value ) {
+      if ( sizeof(T) == 4 ) buffer.putU32((std::uint32_t) value);
+      else buffer.putU64((std::uint64_t) value);
+    } else if ( sizeof(T) == 4 ) {
+      buffer.putFloat((float) value);
+    } else {
+      buffer.putDouble((double) value);
+    }
+  }
+
+  // Zone map of the sorted series [begin, end)
+  SeriesIndexZone zoneOf(const std::vector<std::uint32_t>& order, std::size_t begin, std::size_t end) const {
+    SeriesIndexZone zone;
+    zone.createdMin = std::numeric_limits<std::int64_t>::max();
+    zone.createdMax = std::numeric_limits<std::int64_t>::min();
+    zone.lengthMin  = std::numeric_limits<std::int32_t>::max();
+    zone.lengthMax  = 0;
+    zone.maxYMin = zone.minYMin = std::numeric_limits<double>::infinity();
+    zone.maxYMax = zone.minYMax = -std::numeric_limits<double>::infinity();
+    for ( std::size_t sorted = begin; sorted < end; sorted++ ) {
+      std::uint32_t i = order[sorted];
+      NumericSeriesView<T> series = m_series[i];
+      zone.createdMin = std::min<std::int64_t>(zone.createdMin, m_created[i]);
+      zone.createdMax = std::max<std::int64_t>(zone.createdMax, m_created[i]);
+      zone.lengthMin  = std::min(zone.lengthMin, series.length);
+      zone.lengthMax  = std::max(zone.lengthMax, series.length);
+      zone.maxYMin = std::min(zone.maxYMin, (double) series.m_maxY);
+      zone.maxYMax = std::max(zone.maxYMax, (double) series.m_maxY);
+      zone.minYMin = std::min(zone.minYMin, (double) series.m_minY);
+      zone.minYMax = std::max(zone.minYMax, (double) series.m_minY);
+    }
+    return zone;
+  }
+};
+
+// Read side of a SeriesIndex file, memory-mapped so queries touch only the pages they scan. Opening reads the
+// small columns once to check them (see validColumns). Like TSVReader, a file that cannot be opened or is not
+// a valid index, truncated or corrupt, leaves isOpen() false.
+template <typename T>
+class SeriesIndex
+{
+  static_assert(sizeof(T) == 4 || sizeof(T) == 8, "SeriesIndex stores 4 or 8 byte values");
+
+ public:
+  typedef Hist2DAlignment::Alignment Alignment;
+
+  explicit SeriesIndex(const std::string& filename)
+  {
+    m_fd = ::open(filename.c_str(), O_RDONLY);
+    if ( m_fd < 0 ) return;
+    struct stat st;
+    if ( ::fstat(m_fd, &st) != 0 || st.st_size == 0 ) { close(); return; }
+    m_size = st.st_size;
+    void* mapped = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if ( mapped == MAP_FAILED ) { m_size = 0; close(); return; }
+    m_data = static_cast<const char*>(mapped);
+    if ( !layout() ) close();
+  }
+
+  ~SeriesIndex() { close(); }
+
+  SeriesIndex(const SeriesIndex&) = delete;
+  SeriesIndex& operator=(const SeriesIndex&) = delete;
+
+  bool isOpen() const { return m_data != nullptr; }
+  // Number of series and of points in the index
+  std::size_t size() const { return m_series; }
+  std::size_t points() const { return m_points; }
+  std::size_t groupCount() const { return m_groupCount; }
+  std::string groupName(std::size_t g) const {
+    return std::string(m_groupNames + m_nameOffsets[g], m_nameOffsets[g + 1] - m_nameOffsets[g]);
+  }
+
+  // Series i in created order, its created time and its group id
+  NumericSeriesView<T> series(std::size_t i) const {
+    return NumericSeriesView<T>(m_y + m_pointOffsets[i], m_x + m_pointOffsets[i], m_pointOffsets[i + 1] - m_pointOffsets[i],
+				m_maxY[i], m_minY[i], m_maxX[i], m_minX[i]);
+  }
+  long long created(std::size_t i) const { return m_created[i]; }
+  int group(std::size_t i) const { return m_groups[i]; }
+
+  // Calls func(const NumericSeriesView<T>&, int group, long long created) for every series matching query,
+  // in created order within each group. Returns the number of matching series.
+  template <typename F>
+  std::size_t forEach(const SeriesQuery& query, F func) const {
+    if ( !isOpen() ) return 0;
+    std::size_t first = std::lower_bound(m_created, m_created + m_series, query.createdFrom) - m_created;
+    std::size_t last  = std::lower_bound(m_created, m_created + m_series, query.createdTo) - m_created;
+    std::size_t matched = 0;
+    if ( first >= last ) return matched;
+
+    if ( query.groups.empty() ) {
+      for ( std::size_t block = first / m_blockSize; block * m_blockSize < last; block++ ) {
+	if ( !zoneMatches(m_zones[block], query) ) continue;
+	std::size_t end = std::min<std::size_t>(last, (block + 1) * m_blockSize);
+	for ( std::size_t i = std::max<std::size_t>(first, block * m_blockSize); i < end; i++ ) {
+	  if ( seriesMatches(i, query) ) { func(series(i), m_groups[i], m_created[i]); matched++; }
+	}
+      }
+      return matched;
+    }
+
+    // Each group is walked once, in the order first named, however often the query names it
+    std::vector<std::uint32_t> ids;
+    for ( const std::string& key: query.groups ) {
+      auto found = m_groupIds.find(key);
+      if ( found != m_groupIds.end() && std::find(ids.begin(), ids.end(), found->second) == ids.end() ) ids.push_back(found->second);
+    }
+    for ( std::uint32_t id: ids ) {
+      const std::uint32_t* begin = m_postings + m_postingOffsets[id];
+      const std::uint32_t* end   = m_postings + m_postingOffsets[id + 1];
+      // Postings are series ids in created order, so the created range is one slice of the list
+      const std::uint32_t* p = std::lower_bound(begin, end, (std::uint32_t) first);
+      end = std::lower_bound(p, end, (std::uint32_t) last);
+      while ( p < end ) {
+	std::size_t block = *p / m_blockSize;
+	if ( !zoneMatches(m_zones[block], query) ) {
+	  p = std::lower_bound(p, end, (std::uint32_t) ((block + 1) * m_blockSize));
+	  continue;
+	}
+	if ( seriesMatches(*p, query) ) { func(series(*p), m_groups[*p], m_created[*p]); matched++; }
+	++p;
+      }
+    }
+    return matched;
+  }
+
+  // Adds every series matching query to hist (a Hist2D, or anything with addToHist(view, alignment)).
+  // Returns the number of series added.
+  template <typename Hist>
+  std::size_t addToHist(Hist& hist, const SeriesQuery& query, Alignment alignment) const {
+    return forEach(query, [&](const NumericSeriesView<T>& view, int, long long) { hist.addToHist(view, alignment); });
+  }
+
+  // A new histogram of the series matching query
+  Hist2D<T> histogram(const SeriesQuery& query, Alignment alignment, int xBins = 26, int yBins = 28,
+		      double xMin = -.1, double xMax = 24, double yMin = -.1, double yMax = 25.1) const {
+    Hist2D<T> hist(xBins, yBins, xMin, xMax, yMin, yMax);
+    addToHist(hist, query, alignment);
+    return hist;
+  }
+
+ private:
+  int m_fd = -1;
+  const char* m_data = nullptr;
+  std::size_t m_size = 0;
+  std::size_t m_series = 0;
+  std::size_t m_points = 0;
+  std::size_t m_blockSize = 0;
+  std::size_t m_groupCount = 0;
+  const std::int64_t* m_created = nullptr;
+  const std::uint32_t* m_groups = nullptr;
+  const std::uint64_t* m_pointOffsets = nullptr;
+  const T* m_maxY = nullptr;
+  const T* m_minY = nullptr;
+  const T* m_maxX = nullptr;
+  const T* m_minX = nullptr;
+  const T* m_y = nullptr;
+  const T* m_x = nullptr;
+  const SeriesIndexZone* m_zones = nullptr;
+  const std::uint64_t* m_postingOffsets = nullptr;
+  const std::uint32_t* m_postings = nullptr;
+  const std::uint64_t* m_nameOffsets = nullptr;
+  const char* m_groupNames = nullptr;
+  std::unordered_map<std::string, std::uint32_t> m_groupIds;
+
+  void close() {
+    if ( m_data != nullptr ) ::munmap(const_cast<char*>(m_data), m_size);
+    if ( m_fd >= 0 ) ::close(m_fd);
+    m_data = nullptr;
+    m_fd = -1;
+  }
+
+  static bool littleEndianHost() {
+    std::uint32_t one = 1;
+    char first;
+    std::memcpy(&first, &one, 1);
+    return first == 1;
+  }
+
+  // Checks the header and points every column into the mapping. Returns false for anything that is not
+  // a complete index of T written by SeriesIndexWriter.
+  bool layout() {
+    if ( !littleEndianHost() || m_size < 40 || std::memcmp(m_data, "H2DI", 4) != 0 ) return false;
+    std::uint32_t header[3];
+    std::memcpy(header, m_data + 4, sizeof(header));
+    if ( header[0] != SERIES_INDEX_VERSION || header[1] != sizeof(T) || header[2] != (std::is_integral<T>::value ? 0u : 1u) ) return false;
+    std::uint64_t counts[2];
+    std::memcpy(counts, m_data + 16, sizeof(counts));
+    std::uint32_t shape[2];
+    std::memcpy(shape, m_data + 32, sizeof(shape));
+    m_series = counts[0];
+    m_points = counts[1];
+    m_blockSize = shape[0];
+    m_groupCount = shape[1];
+    if ( m_blockSize == 0 ) return false;
+
+    // Every count is bounded by the file size before it is multiplied, so the section sizes cannot wrap
+    if ( m_series > m_size / 8 || m_points > m_size / sizeof(T) || m_groupCount > m_size / 8 ) return false;
+
+    std::size_t offset = 40;
+    bool fits = true;
+    auto take = [&](std::size_t bytes) -> const char* {
+      const char* section = m_data + offset;
+      if ( !fits || bytes > m_size - offset || (bytes + 7) / 8 * 8 > m_size - offset ) {
+	fits = false;
+	return m_data;
+      }
+      offset += (bytes + 7) / 8 * 8;
+      return section;
+    };
+    std::size_t blocks = (m_series + m_blockSize - 1) / m_blockSize;
+    m_created      = reinterpret_cast<const std::int64_t*>(take(8 * m_series));
+    m_groups       = reinterpret_cast<const std::uint32_t*>(take(4 * m_series));
+    m_pointOffsets = reinterpret_cast<const std::uint64_t*>(take(8 * (m_series + 1)));
+    m_maxY         = reinterpret_cast<const T*>(take(sizeof(T) * m_series));
+    m_minY         = reinterpret_cast<const T*>(take(sizeof(T) * m_series));
+    m_maxX         = reinterpret_cast<const T*>(take(sizeof(T) * m_series));
+    m_minX         = reinterpret_cast<const T*>(take(sizeof(T) * m_series));
+    m_y            = reinterpret_cast<const T*>(take(sizeof(T) * m_points));
+    m_x            = reinterpret_cast<const T*>(take(sizeof(T) * m_points));
+    m_zones        = reinterpret_cast<const SeriesIndexZone*>(take(sizeof(SeriesIndexZone) * blocks));
+    // Postings and their offsets share one section, as do the name offsets and the names
+    m_postingOffsets = reinterpret_cast<const std::uint64_t*>(take(0));
+    take(8 * (m_groupCount + 1) + 4 * m_series);
+    m_postings     = reinterpret_cast<const std::uint32_t*>(m_postingOffsets + m_groupCount + 1);
+    m_nameOffsets  = reinterpret_cast<const std::uint64_t*>(take(8 * (m_groupCount + 1)));
+    if ( !fits || !ascending(m_nameOffsets, m_groupCount + 1, 0, m_size - offset) ) return false;
+    m_groupNames   = take(m_nameOffsets[m_groupCount]);
+    if ( !fits || !validColumns() ) return false;
+    for ( std::size_t g = 0; g < m_groupCount; g++ ) m_groupIds[groupName(g)] = g;
+    return true;
+  }
+
+  // True if values[0..n) starts at first, never decreases and ends at no more than last
+  static bool ascending(const std::uint64_t* values, std::size_t n, std::uint64_t first, std::uint64_t last) {
+    if ( values[0] != first || values[n - 1] > last ) return false;
+    for ( std::size_t i = 1; i < n; i++ ) {
+      if ( values[i] < values[i - 1] ) return false;
+    }
+    return true;
+  }
+
+  // Checks, in one pass over each column, every value that is later used as an index or a length, so that a
+  // corrupt file is rejected here rather than read out of bounds by a query: point offsets run from 0 to the
+  // number of points with series no longer than an int, created times are sorted, group ids are below the
+  // number of groups, and each group's postings are increasing series ids that together cover every series.
+  bool validColumns() const {
+    if ( !ascending(m_pointOffsets, m_series + 1, 0, m_points) || m_pointOffsets[m_series] != m_points ) return false;
+    for ( std::size_t i = 0; i < m_series; i++ ) {
+      if ( m_pointOffsets[i + 1] - m_pointOffsets[i] > (std::uint64_t) std::numeric_limits<int>::max() ) return false;
+      if ( m_groups[i] >= m_groupCount ) return false;
+      if ( i > 0 && m_created[i] < m_created[i - 1] ) return false;
+    }
+    if ( !ascending(m_postingOffsets, m_groupCount + 1, 0, m_series) || m_postingOffsets[m_groupCount] != m_series ) return false;
+    for ( std::size_t g = 0; g < m_groupCount; g++ ) {
+      for ( std::uint64_t k = m_postingOffsets[g]; k < m_postingOffsets[g + 1]; k++ ) {
+	if ( m_postings[k] >= m_series || m_groups[m_postings[k]] != g ) return false;
+	if ( k > m_postingOffsets[g] && m_postings[k] <= m_postings[k - 1] ) return false;
+      }
+    }
+    return true;
+  }
+
+  static bool zoneMatches(const SeriesIndexZone& zone, const SeriesQuery& query) {
+    return zone.lengthMax >= query.lengthMin && zone.lengthMin <= query.lengthMax &&
+      zone.maxYMax >= query.maxYMin && zone.maxYMin <= query.maxYMax &&
+      zone.minYMax >= query.minYMin && zone.minYMin <= query.minYMax;
+  }
+
+  bool seriesMatches(std::size_t i, const SeriesQuery& query) const {
+    long long length = m_pointOffsets[i + 1] - m_pointOffsets[i];
+    return length >= query.lengthMin && length <= query.lengthMax &&
+      m_maxY[i] >= query.maxYMin && m_maxY[i] <= query.maxYMax &&
+      m_minY[i] >= query.minYMin && m_minY[i] <= query.minYMax;
+  }
+};
+
+#endif // SERIES_INDEX
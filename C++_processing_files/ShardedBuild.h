@@ -0,0 +1,54 @@
+#ifndef SHARDED_BUILD
+#define SHARDED_BUILD
+
+#include <thread>
+#include <vector>
+
+#include "TSVReader.h"
+#include "Instrumentation.h"
+
+// Runs a parallel build over a TSVReader. The file is split into byte-range shards on line
+// boundaries and each shard is parsed by its own thread into a private State created by makeState().
+// rowFunc(State&, const SeriesRow<T>&) is called for every row of a shard, in file order.
+// Afterwards the shard states are reduced into the first one, again in file order, with
+// State::merge(State&), so any order-dependent output (such as per-series traits) matches
+// a single-threaded pass over the same file.
+// begin and end limit the build to the rows starting in [begin, end), e.g. the rows appended since a snapshot.
+template <typename T, typename State, typename MakeState, typename RowFunc>
+State buildSharded(const TSVReader& reader, unsigned int threads, MakeState makeState, RowFunc rowFunc,
+		   std::size_t begin = 0, std::size_t end = std::string::npos)
+{
+  if ( threads == 0 ) threads = 1;
+  std::vector<std::size_t> offsets = reader.shardBoundaries(threads, begin, end);
+  std::vector<State> states;
+  states.reserve(threads);
+  for ( unsigned int i = 0; i < threads; i++ ) {
+    states.push_back(makeState());
+  }
+
+  auto work = [&](unsigned int shard) {
+    State& state = states[shard];
+    reader.forEachRow<T>(offsets[shard], offsets[shard + 1], [&](const SeriesRow<T>& row) { rowFunc(state, row); });
+  };
+
+  if ( threads == 1 ) {
+    work(0);
+  } else {
+    std::vector<std::thread> workers;
+    for ( unsigned int i = 0; i < threads; i++ ) {
+      workers.push_back(std::thread(work, i));
+    }
+    for ( auto& worker: workers ) {
+      worker.join();
+    }
+  }
+
+  State result = std::move(states[0]);
+  INSTRUMENT_SCOPE(Merge);
+  for ( unsigned int i = 1; i < threads; i++ ) {
+    result.merge(states[i]);
+  }
+  return result;
+}
+
+#endif // SHARDED_BUILD
@@ -0,0 +1,178 @@
+#ifndef SNAPSHOT
+#define SNAPSHOT
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+#include "TSVReader.h"
+#include "BinaryOutput.h"
+#include "Instrumentation.h"
+
+// A snapshot saves the complete state of an aggregation (e.g. a GroupAggregator: bins, alignment, and every
+// group's histogram, traits and counts) together with how much of the input it has consumed, so a later run
+// can load it and process only the rows appended since, instead of the whole history:
+//
+//   InputPosition position;
+//   if ( !loadSnapshot("state.h2s", aggregator, position) || !position.matches(reader) ) start from scratch;
+//   ... aggregate the rows in [position.offset, reader.completeLinesEnd()) ...
+//   saveSnapshot("state.h2s", aggregator, InputPosition::at(reader, end, rows));
+//
+// The file is little-endian like the other binary containers (see BinaryOutput.h):
+//   char[4]  magic "H2DS"
+//   uint32   format version (SNAPSHOT_VERSION)
+//   uint64   payload size in bytes
+//   uint64   checksum of the payload
+//   payload: uint64 input offset, uint64 rows consumed, uint64 input fingerprint,
+//            then the state as written by the aggregator's appendState
+// The snapshot is memory-mapped when loaded and checked against its checksum before anything is restored,
+// so a truncated or corrupted snapshot is rejected rather than half loaded.
+
+const std::uint32_t SNAPSHOT_VERSION = 2;
+// Bytes of input just before the consumed offset covered by the input fingerprint
+const std::size_t SNAPSHOT_FINGERPRINT_BYTES = 4096;
+
+// Checksum of a block of bytes, eight bytes at a time
+inline std::uint64_t snapshotChecksum(const char* data, std::size_t size)
+{
+  std::uint64_t hash = 0xcbf29ce484222325ULL ^ size;
+  std::size_t i = 0;
+  for ( ; i + 8 <= size; i += 8 ) {
+    std::uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    hash = (hash ^ word) * 0x100000001b3ULL;
+    hash ^= hash >> 29;
+  }
+  for ( ; i < size; i++ ) {
+    hash = (hash ^ (unsigned char) data[i]) * 0x100000001b3ULL;
+  }
+  return hash ^ (hash >> 32);
+}
+
+// How far into its input an aggregation has got
+struct InputPosition
+{
+  std::uint64_t offset = 0;        // bytes of input consumed, always at a line start
+  std::uint64_t rows = 0;          // rows aggregated so far
+  std::uint64_t fingerprint = 0;   // checksum of the input just before offset
+
+  static InputPosition at(const TSVReader& reader, std::size_t offset, std::uint64_t rows) {
+    InputPosition position;
+    position.offset = offset;
+    position.rows = rows;
+    position.fingerprint = fingerprintAt(reader, offset);
+    return position;
+  }
+
+  // True if the input still holds the bytes this position was taken at, i.e. it has only been appended to
+  bool matches(const TSVReader& reader) const {
+    return offset <= reader.size() && fingerprint == fingerprintAt(reader, offset);
+  }
+
+  static std::uint64_t fingerprintAt(const TSVReader& reader, std::size_t offset) {
+    std::size_t start = offset - std::min<std::size_t>(offset, SNAPSHOT_FINGERPRINT_BYTES);
+    return snapshotChecksum(reader.data() + start, offset - start);
+  }
+};
+
+// Bounds-checked little-endian reads from a mapped snapshot. A read past the end returns 0
+// and clears ok(), so a caller can read a whole record and check once at the end.
+class SnapshotReader
+{
+ public:
+  SnapshotReader(const char* data, std::size_t size) : m_data(data), m_size(size), m_position(0), m_ok(true) {}
+
+  std::uint32_t u32() { return (std::uint32_t) littleEndian(4); }
+  std::uint64_t u64() { return littleEndian(8); }
+  double f64() {
+    std::uint64_t bits = littleEndian(8);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+  // The next size bytes, in place
+  FieldView bytes(std::size_t size) {
+    if ( !take(size) ) return FieldView();
+    return FieldView(m_data + m_position - size, size);
+  }
+
+  bool ok() const { return m_ok; }
+  bool atEnd() const { return m_position == m_size; }
+  std::size_t remaining() const { return m_size - m_position; }
+
+ private:
+  const char* m_data;
+  std::size_t m_size;
+  std::size_t m_position;
+  bool m_ok;
+
+  bool take(std::size_t size) {
+    if ( !m_ok || size > m_size - m_position ) { m_ok = false; return false; }
+    m_position += size;
+    return true;
+  }
+
+  std::uint64_t littleEndian(int size) {
+    if ( !take(size) ) return 0;
+    std::uint64_t value = 0;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(m_data + m_position - size);
+    for ( int i = 0; i < size; i++ ) value |= (std::uint64_t) p[i] << (8 * i);
+    return value;
+  }
+};
+
+// Saves state (anything with appendState(BinaryBuffer&)) and position to filename.
+// Returns false if the file could not be written.
+template <typename State>
+bool saveSnapshot(const std::string& filename, const State& state, const InputPosition& position)
+{
+  INSTRUMENT_SCOPE(Write);
+  BinaryBuffer payload;
+  payload.putU64(position.offset);
+  payload.putU64(position.rows);
+  payload.putU64(position.fingerprint);
+  state.appendState(payload);
+
+  BinaryBuffer buffer;
+  buffer.reserve(24 + payload.bytes().size());
+  buffer.putBytes("H2DS", 4);
+  buffer.putU32(SNAPSHOT_VERSION);
+  buffer.putU64(payload.bytes().size());
+  buffer.putU64(snapshotChecksum(payload.bytes().data(), payload.bytes().size()));
+  buffer.putBytes(payload.bytes().data(), payload.bytes().size());
+  // Written next to the old snapshot and renamed over it, so a crash never leaves a partial snapshot behind
+  std::string temporary = filename + ".tmp";
+  if ( !buffer.writeFile(temporary) ) return false;
+  return std::rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+// Restores state (anything with restoreState(SnapshotReader&), which must leave the state unchanged when it
+// returns false) and position from filename. Returns false, with state and position untouched, if the file is
+// missing, corrupt or was written for a differently configured state; the caller then starts from the
+// beginning of the input.
+template <typename State>
+bool loadSnapshot(const std::string& filename, State& state, InputPosition& position)
+{
+  TSVReader file(filename);   // used here only to map the file
+  if ( file.data() == nullptr || file.size() < 24 || std::memcmp(file.data(), "H2DS", 4) != 0 ) return false;
+  SnapshotReader header(file.data() + 4, 20);
+  std::uint32_t version = header.u32();
+  std::uint64_t size = header.u64();
+  std::uint64_t checksum = header.u64();
+  if ( version != SNAPSHOT_VERSION || size != file.size() - 24 ) return false;
+  const char* payload = file.data() + 24;
+  if ( snapshotChecksum(payload, size) != checksum ) return false;
+
+  SnapshotReader in(payload, size);
+  InputPosition loaded;
+  loaded.offset = in.u64();
+  loaded.rows = in.u64();
+  loaded.fingerprint = in.u64();
+  if ( !in.ok() || !state.restoreState(in) ) return false;
+  position = loaded;
+  return true;
+}
+
+#endif // SNAPSHOT
@@ -0,0 +1,185 @@
+#ifndef STREAMING_PIPELINE
+#define STREAMING_PIPELINE
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "BoundedQueue.h"
+#include "TSVReader.h"
+#include "FlatVectorOfNumericVectors.h"
+#include "Instrumentation.h"
+
+// The streaming pipeline processes a scrape file of any size in bounded memory, as three stages
+// joined by BoundedQueues:
+//   reader     reads the file with plain read() calls into a small pool of fixed-size text chunks.
+//              A line cut off at the end of a chunk is carried over to the start of the next one.
+//   parser     splits each chunk into lines, parses them with TSVReader::parseRow and lets
+//              rowFunc(const SeriesRow<T>&, SeriesBatch<T>&) add any number of series to a batch.
+//   aggregator runs on the calling thread and hands each series of a batch to
+//              sink(const std::string& key, NumericSeriesView<T>&), in file order.
+// Chunks and batches are recycled through return queues, so after start-up nothing is allocated and
+// the data in flight is capped at depth chunks and depth batches, however large the input is.
+// Reading, parsing and aggregation overlap one another.
+
+// A group of parsed series with the key each belongs to. Keys and storage are reused across batches.
+template <typename T>
+class SeriesBatch
+{
+ public:
+  SeriesBatch() : m_keyCount(0) {}
+
+  void clear() {
+    m_keyCount = 0;
+    m_series.clear();
+  }
+
+  // Adds a series of n paired y and x values under key. Empty series are ignored.
+  void add(const FieldView& key, const T* y, const T* x, int n) {
+    if ( n <= 0 ) return;
+    if ( m_keyCount == m_keys.size() ) m_keys.push_back(std::string());
+    m_keys[m_keyCount++].assign(key.data, key.size);
+    m_series.AddToVector(y, x, n);
+  }
+
+  void add(const FieldView& key, const std::vector<T>& y, const std::vector<T>& x) {
+    add(key, y.data(), x.data(), y.size());
+  }
+
+  std::size_t size() const { return m_keyCount; }
+  std::size_t points() const { return m_series.points(); }
+  const std::string& key(std::size_t i) const { return m_keys[i]; }
+  NumericSeriesView<T> series(std::size_t i) const { return m_series[i]; }
+
+ private:
+  std::vector<std::string> m_keys;
+  std::size_t m_keyCount;
+  FlatVectorOfNumericVectors<T> m_series;
+};
+
+// Sizes of the pipeline's buffers
+struct PipelineOptions
+{
+  std::size_t chunkBytes  = 4 << 20;   // bytes read per text chunk; grown only for a line longer than this
+  std::size_t batchPoints = 1 << 16;   // points per batch handed to the aggregator
+  std::size_t depth       = 4;         // chunks and batches allocated for each stage
+};
+
+// Streams filename through the pipeline described above.
+// Returns false, without calling rowFunc or sink, if the file cannot be opened. Also returns false if a read
+// fails partway (a read interrupted by a signal is retried); the rows before the error have then been passed
+// on, and the caller should treat its results as incomplete.
+template <typename T, typename RowFunc, typename Sink>
+bool streamSeries(const std::string& filename, RowFunc rowFunc, Sink sink, PipelineOptions options = PipelineOptions())
+{
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if ( fd < 0 ) return false;
+  if ( options.depth < 2 ) options.depth = 2;
+  if ( options.chunkBytes < 2 ) options.chunkBytes = 2;
+
+  typedef std::vector<char> TextChunk;   // holds only whole lines once filled
+  BoundedQueue<TextChunk> freeText(options.depth), fullText(options.depth);
+  BoundedQueue<SeriesBatch<T>> freeBatches(options.depth), fullBatches(options.depth);
+  for ( std::size_t i = 0; i < options.depth; i++ ) {
+    freeText.push(TextChunk());
+    freeBatches.push(SeriesBatch<T>());
+  }
+
+  bool readFailed = false;
+  std::thread reader([&] {
+    std::vector<char> carry;
+    TextChunk chunk;
+    bool done = false;
+    while ( !done ) {
+      freeText.pop(chunk);
+      chunk.resize(std::max(options.chunkBytes, carry.size() * 2));
+      std::copy(carry.begin(), carry.end(), chunk.begin());
+      std::size_t filled = carry.size();
+      carry.clear();
+      // Fills the chunk, growing it only when it does not yet hold a single complete line
+      while ( true ) {
+	ssize_t got;
+	{
+	  INSTRUMENT_SCOPE(Read);
+	  got = ::read(fd, chunk.data() + filled, chunk.size() - filled);
+	}
+	if ( got < 0 && errno == EINTR ) continue;
+	if ( got <= 0 ) {
+	  readFailed = got < 0;
+	  done = true;
+	  break;
+	}
+	INSTRUMENT_COUNT(BytesRead, got);
+	filled += got;
+	if ( filled < chunk.size() ) continue;
+	if ( std::memchr(chunk.data(), '\n', filled) != nullptr ) break;
+	chunk.resize(chunk.size() * 2);
+      }
+      std::size_t whole = filled;
+      if ( !done ) {
+	while ( chunk[whole - 1] != '\n' ) whole--;
+	carry.assign(chunk.begin() + whole, chunk.begin() + filled);
+      }
+      chunk.resize(whole);
+      fullText.push(std::move(chunk));
+    }
+    fullText.close();
+  });
+
+  std::thread parser([&] {
+    SeriesRow<T> row;
+    SeriesBatch<T> batch;
+    TextChunk chunk;
+    freeBatches.pop(batch);
+    while ( fullText.pop(chunk) ) {
+      const char* p   = chunk.data();
+      const char* end = p + chunk.size();
+      while ( p < end ) {
+	const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+	if ( eol == nullptr ) eol = end;
+	bool parsed;
+	{
+	  INSTRUMENT_SCOPE(Parse);
+	  parsed = TSVReader::parseRow(p, eol, row);
+	}
+	if ( parsed ) {
+	  INSTRUMENT_COUNT(Rows, 1);
+	  rowFunc(static_cast<const SeriesRow<T>&>(row), batch);
+	  if ( batch.points() >= options.batchPoints ) {
+	    fullBatches.push(std::move(batch));
+	    freeBatches.pop(batch);
+	    batch.clear();
+	  }
+	}
+	p = eol + 1;
+      }
+      freeText.push(std::move(chunk));
+    }
+    if ( batch.size() > 0 ) fullBatches.push(std::move(batch));
+    fullBatches.close();
+  });
+
+  SeriesBatch<T> batch;
+  while ( fullBatches.pop(batch) ) {
+    for ( std::size_t i = 0; i < batch.size(); i++ ) {
+      NumericSeriesView<T> series = batch.series(i);
+      sink(batch.key(i), series);
+    }
+    batch.clear();
+    freeBatches.push(std::move(batch));
+  }
+
+  reader.join();
+  parser.join();
+  ::close(fd);
+  return !readFailed;
+}
+
+#endif // STREAMING_PIPELINE
@@ -0,0 +1,136 @@
+#ifndef SYNTHETIC_SERIES
+#define SYNTHETIC_SERIES
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+
+// SyntheticSeries generates ragged series shaped like the Reddit scrape: each series belongs to one
+// of a fixed number of groups, has a random length, and holds rank values that drift by small steps
+// together with timestamps one scrape interval apart. Output depends only on the configuration and
+// the seed, so every build benchmarks exactly the same data. Series are produced one at a time,
+// so arbitrarily many points (including billions, streamed to a TSV file) can be generated in constant memory.
+
+// SplitMix64 generator: tiny, fast and statistically sound enough for benchmark inputs
+class SplitMix64
+{
+ public:
+  explicit SplitMix64(std::uint64_t seed) : m_state(seed) {}
+
+  std::uint64_t next() {
+    std::uint64_t z = (m_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  // Uniform integer in [0, bound)
+  std::uint64_t below(std::uint64_t bound) { return next() % bound; }
+
+  // Uniform double in [0, 1)
+  double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+ private:
+  std::uint64_t m_state;
+};
+
+struct SyntheticConfig
+{
+  enum class Lengths {
+    Uniform,    // every length in [minLength, maxLength] equally likely
+    Geometric   // lengths from minLength with the given mean, cut off at maxLength; most series are short
+  };
+
+  std::uint64_t seed = 42;
+  Lengths lengths = Lengths::Geometric;
+  int minLength = 1;
+  int maxLength = 48;
+  double meanLength = 6;
+  int valueDomain = 25;                  // ranks are drawn from [0, valueDomain)
+  int maxStep = 3;                       // largest change in rank between consecutive points
+  int groups = 50;                       // number of distinct group keys (subreddits)
+  long long startTime = 1434000000;      // created time of the first series
+  long long interval = 3600;             // seconds between recorded points
+};
+
+class SyntheticSeries
+{
+ public:
+  explicit SyntheticSeries(const SyntheticConfig& config = SyntheticConfig())
+    : m_config(config), m_random(config.seed), m_created(config.startTime), m_count(0) {}
+
+  // Fills y with the next series' ranks and x with its recorded-at timestamps and returns its group.
+  template <typename T>
+  int next(std::vector<T>& y, std::vector<T>& x) {
+    int length = nextLength();
+    y.resize(length);
+    x.resize(length);
+    int group = m_random.below(m_config.groups);
+    m_created += m_random.below(2 * m_config.interval / std::max(1, m_config.groups) + 1);
+    long long recorded = m_created + m_random.below(m_config.interval);
+    long long value = m_random.below(m_config.valueDomain);
+    for ( int i = 0; i < length; i++ ) {
+      y[i] = (T) value;
+      x[i] = (T) recorded;
+      recorded += m_config.interval;
+      long long step = (long long) m_random.below(2 * m_config.maxStep + 1) - m_config.maxStep;
+      value = std::min<long long>(std::max<long long>(value + step, 0), m_config.valueDomain - 1);
+    }
+    m_count++;
+    return group;
+  }
+
+  // Created time of the series returned by the last call to next()
+  long long created() const { return m_created; }
+  // Number of series generated so far
+  long long count() const { return m_count; }
+
+  static std::string groupName(int group) { return "group" + std::to_string(group); }
+
+  // Writes series in the scrape file layout read by TSVReader, header first, until at least
+  // points values have been written. Returns the number of points written.
+  long long writeTSV(std::FILE* out, long long points) {
+    std::fputs("comp\tid\tsubreddit\tcreated\tranks\trecorded_at\trank_length\n", out);
+    std::vector<long long> y, x;
+    long long written = 0;
+    while ( written < points ) {
+      int group = next(y, x);
+      std::fprintf(out, "0\t%llx\tgroup%d\t%lld.0\t[", (unsigned long long) m_count, group, m_created);
+      writeList(out, y);
+      std::fputs("]\t[", out);
+      writeList(out, x);
+      std::fprintf(out, "]\t%d.0\n", (int) y.size());
+      written += y.size();
+    }
+    return written;
+  }
+
+ private:
+  SyntheticConfig m_config;
+  SplitMix64 m_random;
+  long long m_created;
+  long long m_count;
+
+  int nextLength() {
+    int span = m_config.maxLength - m_config.minLength;
+    if ( span <= 0 ) return m_config.minLength;
+    if ( m_config.lengths == SyntheticConfig::Lengths::Uniform ) {
+      return m_config.minLength + m_random.below(span + 1);
+    }
+    // Counts failures before a success with probability 1 / (mean - min + 1)
+    double p = 1.0 / std::max(1.0, m_config.meanLength - m_config.minLength + 1);
+    int extra = 0;
+    while ( extra < span && m_random.uniform() >= p ) extra++;
+    return m_config.minLength + extra;
+  }
+
+  static void writeList(std::FILE* out, const std::vector<long long>& values) {
+    for ( std::size_t i = 0; i < values.size(); i++ ) {
+      std::fprintf(out, i == 0 ? "%lld" : ", %lld", values[i]);
+    }
+  }
+};
+
+#endif // SYNTHETIC_SERIES
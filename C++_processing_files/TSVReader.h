@@ -0,0 +1,220 @@
+#ifndef TSV_READER
+#define TSV_READER
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Instrumentation.h"
+
+// TSVReader memory-maps a scrape file laid out as
+//   comp  id  subreddit  created  ranks  recorded_at  rank_length
+// and parses each row in place. Integer columns are read straight out of the mapped bytes,
+// and the text columns are handed back as FieldViews pointing into the mapping, so no
+// per-token std::string is ever built. Rows whose ranks column does not start with '['
+// (such as the header line) are skipped.
+
+// Non-owning view of a single field within the mapped file.
+// Only valid for as long as the TSVReader that produced it is alive.
+struct FieldView
+{
+  const char* data;
+  std::size_t size;
+
+  FieldView() : data(nullptr), size(0) {}
+  FieldView(const char* d, std::size_t s) : data(d), size(s) {}
+
+  std::string str() const { return std::string(data, size); }
+  bool empty() const { return size == 0; }
+};
+
+// One parsed row of the scrape file. The rank and timestamp vectors are reused from row
+// to row, so after the first few rows parsing does not allocate at all.
+template <typename T>
+struct SeriesRow
+{
+  FieldView comp;
+  FieldView id;
+  FieldView subreddit;
+  long long created;      // integer part of the created column
+  std::vector<T> ranks;
+  std::vector<T> recordedAt;
+  long long rankLength;   // integer part of the rank_length column
+};
+
+class TSVReader
+{
+ public:
+  explicit TSVReader(const std::string& filename)
+    : m_data(nullptr), m_size(0), m_fd(-1)
+  {
+    m_fd = ::open(filename.c_str(), O_RDONLY);
+    if ( m_fd < 0 ) return;
+    struct stat st;
+    if ( ::fstat(m_fd, &st) != 0 ) { close(); return; }
+    m_size = st.st_size;
+    if ( m_size == 0 ) return;   // empty file is open but has no rows
+    void* mapped = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if ( mapped == MAP_FAILED ) { close(); return; }
+    ::madvise(mapped, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const char*>(mapped);
+  }
+
+  ~TSVReader() { close(); }
+
+  TSVReader(const TSVReader&) = delete;
+  TSVReader& operator=(const TSVReader&) = delete;
+
+  bool isOpen() const { return m_fd >= 0; }
+  std::size_t size() const { return m_size; }
+  const char* data() const { return m_data; }
+
+  // Splits the file into shards byte ranges of roughly equal size whose boundaries fall on line starts.
+  // Returns shards + 1 offsets; shard i covers [offsets[i], offsets[i+1]). Shards may be empty.
+  // begin and end restrict the split to part of the file; begin should itself be a line start.
+  std::vector<std::size_t> shardBoundaries(unsigned int shards, std::size_t begin = 0, std::size_t end = std::string::npos) const {
+    end = std::min(end, m_size);
+    begin = std::min(begin, end);
+    std::vector<std::size_t> offsets(1, begin);
+    if ( shards == 0 ) shards = 1;
+    for ( unsigned int i = 1; i < shards; i++ ) {
+      std::size_t offset = std::max(offsets.back(), begin + (end - begin) / shards * i);
+      if ( offset > 0 && offset < end && m_data[offset - 1] != '\n' ) {
+	const char* eol = static_cast<const char*>(std::memchr(m_data + offset, '\n', end - offset));
+	offset = eol == nullptr ? end : (eol - m_data) + 1;
+      }
+      offsets.push_back(offset);
+    }
+    offsets.push_back(end);
+    return offsets;
+  }
+
+  // Offset just past the last newline, i.e. the end of the last complete line. A file that is still
+  // being appended to may end in a partial line, which is left for a later run to pick up.
+  std::size_t completeLinesEnd() const {
+    const char* p = m_data + m_size;
+    while ( p > m_data && *(p - 1) != '\n' ) --p;
+    return p - m_data;
+  }
+
+  // Calls func(const SeriesRow<T>&) once for every data row in the file, in file order.
+  // Returns the number of rows handed to func.
+  template <typename T, typename F>
+  std::size_t forEachRow(F func) const {
+    return forEachRow<T>(0, m_size, func);
+  }
+
+  // Same as above but restricted to the rows that start within [begin, end)
+  template <typename T, typename F>
+  std::size_t forEachRow(std::size_t begin, std::size_t end, F func) const {
+    SeriesRow<T> row;
+    std::size_t rows = 0;
+    if ( m_data == nullptr ) return rows;
+    const char* p    = m_data + begin;
+    const char* stop = m_data + std::min(end, m_size);
+    const char* fileEnd = m_data + m_size;
+    while ( p < stop ) {
+      const char* eol = static_cast<const char*>(std::memchr(p, '\n', fileEnd - p));
+      if ( eol == nullptr ) eol = fileEnd;
+      INSTRUMENT_COUNT(BytesRead, eol - p + 1);
+      bool parsed;
+      {
+	INSTRUMENT_SCOPE(Parse);
+	parsed = parseRow(p, eol, row);
+      }
+      if ( parsed ) {
+	INSTRUMENT_COUNT(Rows, 1);
+	func(static_cast<const SeriesRow<T>&>(row));
+	rows++;
+      }
+      p = eol + 1;
+    }
+    return rows;
+  }
+
+  // Parses a single line (without its trailing newline) into row.
+  // Returns false for lines that do not carry a series, e.g. the header or a blank line,
+  // and for malformed rows whose ranks and timestamps differ in number.
+  template <typename T>
+  static bool parseRow(const char* begin, const char* end, SeriesRow<T>& row) {
+    if ( end > begin && *(end - 1) == '\r' ) --end;
+    const char* p = begin;
+    row.comp      = nextField(p, end);
+    row.id        = nextField(p, end);
+    row.subreddit = nextField(p, end);
+    FieldView created = nextField(p, end);
+    FieldView ranks   = nextField(p, end);
+    FieldView stamps  = nextField(p, end);
+    FieldView length  = nextField(p, end);
+    if ( ranks.empty() || ranks.data[0] != '[' || stamps.empty() || stamps.data[0] != '[' ) return false;
+
+    const char* q = created.data;
+    row.created = parseInt<long long>(q, created.data + created.size);
+    q = length.data;
+    row.rankLength = parseInt<long long>(q, length.data + length.size);
+    parseList(ranks, row.ranks);
+    parseList(stamps, row.recordedAt);
+    return row.ranks.size() == row.recordedAt.size();
+  }
+
+ private:
+  const char* m_data;
+  std::size_t m_size;
+  int m_fd;
+
+  void close() {
+    if ( m_data != nullptr ) ::munmap(const_cast<char*>(m_data), m_size);
+    if ( m_fd >= 0 ) ::close(m_fd);
+    m_data = nullptr;
+    m_fd = -1;
+  }
+
+  // Returns the field starting at p and advances p past the following tab
+  static FieldView nextField(const char*& p, const char* end) {
+    const char* start = p;
+    while ( p < end && *p != '\t' ) ++p;
+    FieldView field(start, p - start);
+    if ( p < end ) ++p;
+    return field;
+  }
+
+  // Parses an optionally signed decimal integer at p, stopping at the first non-digit
+  template <typename I>
+  static I parseInt(const char*& p, const char* end) {
+    bool negative = false;
+    if ( p < end && (*p == '-' || *p == '+') ) {
+      negative = (*p == '-');
+      ++p;
+    }
+    I value = 0;
+    while ( p < end && (unsigned)(*p - '0') < 10u ) {
+      value = value*10 + (*p - '0');
+      ++p;
+    }
+    return negative ? -value : value;
+  }
+
+  // Parses a bracketed list such as "[1, 1, 3, 5]" into out
+  template <typename T>
+  static void parseList(const FieldView& field, std::vector<T>& out) {
+    out.clear();
+    const char* p   = field.data + 1;
+    const char* end = field.data + field.size;
+    while ( p < end ) {
+      while ( p < end && (*p == ' ' || *p == ',') ) ++p;
+      if ( p >= end || *p == ']' ) break;
+      out.push_back(static_cast<T>(parseInt<long long>(p, end)));
+      // Skips any fractional part or other trailing characters of the token
+      while ( p < end && *p != ',' && *p != ']' ) ++p;
+    }
+  }
+};
+
+#endif // TSV_READER
@@ -0,0 +1,126 @@
+#ifndef TILED_COUNTS
+#define TILED_COUNTS
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <algorithm>
+
+// TiledCounts is a sparse rows x cols grid of counters for very large, mostly empty histograms.
+// The grid is cut into fixed TILE_ROWS x TILE_COLS blocks that are only allocated when one of their
+// cells is first written, so memory grows with the occupied area rather than with the full grid.
+// Reading a cell of an untouched tile returns 0 without allocating. Within a tile, counters are laid
+// out row by row exactly like a dense matrix, so repeated writes to a hot tile cost one extra pointer load.
+template <typename CountT>
+class TiledCounts
+{
+ public:
+  static const int TILE_ROWS = 8;
+  static const int TILE_COLS = 512;
+  static const int TILE_SIZE = TILE_ROWS * TILE_COLS;
+
+  TiledCounts(int rows = 0, int cols = 0)
+    : m_rows(rows), m_cols(cols),
+    m_tileRows((rows + TILE_ROWS - 1) / TILE_ROWS), m_tileCols((cols + TILE_COLS - 1) / TILE_COLS),
+    m_tiles(m_tileRows * m_tileCols)
+  {}
+
+  TiledCounts(const TiledCounts& other)
+    : m_rows(other.m_rows), m_cols(other.m_cols), m_tileRows(other.m_tileRows), m_tileCols(other.m_tileCols),
+    m_tiles(other.m_tiles.size())
+  {
+    for ( std::size_t t = 0; t < m_tiles.size(); t++ ) {
+      if ( other.m_tiles[t] ) m_tiles[t] = copyTile(other.m_tiles[t].get());
+    }
+  }
+
+  TiledCounts& operator=(const TiledCounts& other) {
+    TiledCounts copy(other);
+    std::swap(m_rows, copy.m_rows);
+    std::swap(m_cols, copy.m_cols);
+    std::swap(m_tileRows, copy.m_tileRows);
+    std::swap(m_tileCols, copy.m_tileCols);
+    m_tiles.swap(copy.m_tiles);
+    return *this;
+  }
+
+  TiledCounts(TiledCounts&&) = default;
+  TiledCounts& operator=(TiledCounts&&) = default;
+
+  // Writable counter at (row, col), allocating its tile on first touch
+  CountT& at(int row, int col) {
+    std::unique_ptr<CountT[]>& tile = m_tiles[tileIndex(row, col)];
+    if ( !tile ) tile = newTile();
+    return tile[offsetInTile(row, col)];
+  }
+
+  // Value of the counter at (row, col), 0 if its tile was never touched
+  CountT get(int row, int col) const {
+    const std::unique_ptr<CountT[]>& tile = m_tiles[tileIndex(row, col)];
+    return tile ? tile[offsetInTile(row, col)] : CountT(0);
+  }
+
+  // Adds every counter of other, which must have the same shape, allocating tiles only where other has them
+  void add(const TiledCounts& other) {
+    for ( std::size_t t = 0; t < m_tiles.size(); t++ ) {
+      const CountT* from = other.m_tiles[t].get();
+      if ( from == nullptr ) continue;
+      if ( !m_tiles[t] ) {
+	m_tiles[t] = copyTile(from);
+	continue;
+      }
+      CountT* to = m_tiles[t].get();
+      for ( int i = 0; i < TILE_SIZE; i++ ) to[i] += from[i];
+    }
+  }
+
+  // Subtracts every counter of other, which must have the same shape
+  void subtract(const TiledCounts& other) {
+    for ( std::size_t t = 0; t < m_tiles.size(); t++ ) {
+      const CountT* from = other.m_tiles[t].get();
+      if ( from == nullptr ) continue;
+      if ( !m_tiles[t] ) m_tiles[t] = newTile();
+      CountT* to = m_tiles[t].get();
+      for ( int i = 0; i < TILE_SIZE; i++ ) to[i] -= from[i];
+    }
+  }
+
+  // Releases every tile, setting all counters back to 0
+  void clear() {
+    for ( auto& tile: m_tiles ) tile.reset();
+  }
+
+  int rows() const { return m_rows; }
+  int cols() const { return m_cols; }
+  std::size_t allocatedTiles() const {
+    return std::count_if(m_tiles.begin(), m_tiles.end(), [](const std::unique_ptr<CountT[]>& t) { return (bool) t; });
+  }
+  // Bytes held by allocated tiles plus the tile table itself
+  std::size_t memoryBytes() const {
+    return allocatedTiles() * TILE_SIZE * sizeof(CountT) + m_tiles.size() * sizeof(m_tiles[0]);
+  }
+
+ private:
+  int m_rows;
+  int m_cols;
+  int m_tileRows;
+  int m_tileCols;
+  std::vector<std::unique_ptr<CountT[]>> m_tiles;
+
+  std::size_t tileIndex(int row, int col) const {
+    return (std::size_t) (row / TILE_ROWS) * m_tileCols + col / TILE_COLS;
+  }
+  static int offsetInTile(int row, int col) {
+    return (row % TILE_ROWS) * TILE_COLS + col % TILE_COLS;
+  }
+  static std::unique_ptr<CountT[]> newTile() {
+    return std::unique_ptr<CountT[]>(new CountT[TILE_SIZE]());
+  }
+  static std::unique_ptr<CountT[]> copyTile(const CountT* from) {
+    std::unique_ptr<CountT[]> tile(new CountT[TILE_SIZE]);
+    std::copy(from, from + TILE_SIZE, tile.get());
+    return tile;
+  }
+};
+
+#endif // TILED_COUNTS
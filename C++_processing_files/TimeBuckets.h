@@ -0,0 +1,64 @@
+#ifndef TIME_BUCKETS
+#define TIME_BUCKETS
+
+#include <cstddef>
+
+// TimeBuckets converts seconds-since-epoch timestamps into coarser time units using integer
+// arithmetic only, so it needs no gmtime/strftime round trip, shares no static state between
+// threads, and the array versions are plain loops the compiler can vectorize.
+// A fixed UTC offset in seconds is added before bucketing, e.g. 5 * 3600 to reproduce the
+// +5 hour shift applied to the Reddit scrape times.
+class TimeBuckets
+{
+ public:
+  explicit TimeBuckets(long long utcOffsetSeconds = 0) : m_offset(utcOffsetSeconds) {}
+
+  // Hour of the day, 0-23
+  int hourOfDay(long long timestamp) const {
+    return floorMod(timestamp + m_offset, SECONDS_PER_DAY) / SECONDS_PER_HOUR;
+  }
+
+  // Day of the week, 0 = Sunday ... 6 = Saturday (1970-01-01 was a Thursday)
+  int dayOfWeek(long long timestamp) const {
+    return floorMod(floorDiv(timestamp + m_offset, SECONDS_PER_DAY) + 4, 7);
+  }
+
+  // Whole minutes since the epoch, in buckets of the given number of minutes
+  long long minutesSinceEpoch(long long timestamp, long long bucketMinutes = 1) const {
+    return floorDiv(timestamp + m_offset, 60 * bucketMinutes) * bucketMinutes;
+  }
+
+  // Array versions of the above, reading n timestamps from in and writing n results to out.
+  // in and out may be the same array.
+  template <typename In, typename Out>
+  void hourOfDay(const In* in, std::size_t n, Out* out) const {
+    for ( std::size_t i = 0; i < n; i++ ) out[i] = hourOfDay(in[i]);
+  }
+
+  template <typename In, typename Out>
+  void dayOfWeek(const In* in, std::size_t n, Out* out) const {
+    for ( std::size_t i = 0; i < n; i++ ) out[i] = dayOfWeek(in[i]);
+  }
+
+  template <typename In, typename Out>
+  void minutesSinceEpoch(const In* in, std::size_t n, Out* out, long long bucketMinutes = 1) const {
+    for ( std::size_t i = 0; i < n; i++ ) out[i] = minutesSinceEpoch(in[i], bucketMinutes);
+  }
+
+ private:
+  static const long long SECONDS_PER_HOUR = 3600;
+  static const long long SECONDS_PER_DAY  = 86400;
+
+  long long m_offset;
+
+  // Division and remainder rounding towards negative infinity, so times before the epoch bucket correctly
+  static long long floorDiv(long long a, long long b) {
+    long long q = a / b;
+    return q - ((a % b != 0) & ((a < 0) != (b < 0)));
+  }
+  static long long floorMod(long long a, long long b) {
+    return a - floorDiv(a, b) * b;
+  }
+};
+
+#endif // TIME_BUCKETS
@@ -1,6 +1,8 @@
 #ifndef VECTOR_NUMERIC_VECTORS
 #define VECTOR_NUMERIC_VECTORS
 
+#include <limits>
+
 #include "NumericVector.h"
 
 /*
@@ -9,7 +11,8 @@ rather than across an individual series. The max and min values of the x and y v
 taken together are tracked. Also the class computes and returns a concatenated single vector putting together
 the entire series for cases when the user wants to perform additional custom summary statitics on the set as a whole
 in a convenient container. 
-Best to run Concatenate() only when list is complete.
+Once Concatenate() has run, further series added with AddToVector are appended to the
+concatenated vector in place, so building a set incrementally stays linear in its total size.
  */
 
 template <typename T,
@@ -18,11 +21,16 @@ class VectorOfNumericVectors
 {
  public:
  VectorOfNumericVectors()
-   : m_wasConcatenated(false), m_statsCurrent(false)
+   : m_wasConcatenated(false), m_statsCurrent(false),
+   m_maxLength(0), m_minLength(std::numeric_limits<int>::max()),
+   m_maxY(std::numeric_limits<T>::lowest()), m_minY(std::numeric_limits<T>::max()),
+   m_maxX(std::numeric_limits<T>::lowest()), m_minX(std::numeric_limits<T>::max())
     {}
  VectorOfNumericVectors(const std::vector<NumericVector<T>>& vec)
-   : m_vec(vec), m_wasConcatenated(false), m_statsCurrent(false)
-    {}
+   : VectorOfNumericVectors()
+    {
+      m_vec = vec;
+    }
 
   //each time a NumericVector is added to the VectorOfNumericVectors update aggregate measurements
   void AddToVector(const NumericVector<T>& list){
@@ -31,50 +39,38 @@ class VectorOfNumericVectors
     m_minLength = std::min(m_minLength, list.length);
     m_maxY = std::max(m_maxY, list.m_maxY);
     m_minY = std::min(m_minY, list.m_minY);
-    m_maxX = std::max(m_maxY, list.m_maxX);
-    m_minX = std::min(m_minY, list.m_minX);    
+    m_maxX = std::max(m_maxX, list.m_maxX);
+    m_minX = std::min(m_minX, list.m_minX);
 
+    // Extends the existing concatenation in place rather than rebuilding it
     if ( m_wasConcatenated ) {
-      std::vector<T> newX, newY;
-      
-      newX.assign(m_concatenatedVector.getXConst().begin(), m_concatenatedVector.getXConst().end());
-      newX.insert(newX.end(), list.getXConst().begin(), list.getXConst().end());
-
-      newY.assign(m_concatenatedVector.getYConst().begin(), m_concatenatedVector.getYConst().end());
-      newY.insert(newY.end(), list.getYConst().begin(), list.getYConst().end());
-      
-      m_concatenatedVector = NumericVector<T>(newY, newX);
-      }
+      m_concatenatedVector.append(list);
+    }
   }
  
   //concatenate values of all NumericVectors
   void Concatenate(){
     if ( !m_wasConcatenated ) {
       std::vector<T> toConcatY, toConcatX;
-      std::vector<T> yHolder, xHolder;
-      if ( m_statsCurrent ) {
-	for ( auto it = m_vec.begin(); it != m_vec.end(); it++){
-	  yHolder = (*it).getYConst();
-	  xHolder   = (*it).getXConst();
-	  toConcatY.insert(toConcatY.end(), yHolder.begin(), yHolder.end());
-	  toConcatX.insert(toConcatX.end(), xHolder.begin(), xHolder.end());
-	}
-      } else {
-	for ( auto it = m_vec.begin(); it != m_vec.end(); it++ ) {
-	  yHolder = (*it).getYConst();
-	  xHolder   = (*it).getXConst();
-	  toConcatY.insert(toConcatY.end(), yHolder.begin(), yHolder.end());
-	  toConcatX.insert(toConcatX.end(), xHolder.begin(), xHolder.end());
+      for ( auto it = m_vec.begin(); it != m_vec.end(); it++ ) {
+	const std::vector<T>& yHolder = (*it).getYConst();
+	const std::vector<T>& xHolder = (*it).getXConst();
+	toConcatY.insert(toConcatY.end(), yHolder.begin(), yHolder.end());
+	toConcatX.insert(toConcatX.end(), xHolder.begin(), xHolder.end());
+	if ( !m_statsCurrent ) {
 	  int new_length = yHolder.size();
 	  m_maxLength = std::max(m_maxLength, new_length);
 	  m_minLength = std::min(m_minLength, new_length);
 	}
       }
-      m_concatenatedVector = NumericVector<T>(toConcatY, toConcatX);
+      if ( !toConcatY.empty() ) {
+	m_concatenatedVector = NumericVector<T>(toConcatY, toConcatX);
+      }
+      m_wasConcatenated = true;
     } 
   }
 
-  const NumericVector<T> getConcatenated() {
+  const NumericVector<T>& getConcatenated() {
     if ( !m_wasConcatenated ) Concatenate(); 
     return m_concatenatedVector;
   }
@@ -86,9 +82,12 @@ class VectorOfNumericVectors
       m_maxX   = m_concatenatedVector.m_maxX;
       m_minX   = m_concatenatedVector.m_minX;
     }
-    return std::vector<double> {m_maxLength, m_minLength, m_maxY, m_minY, m_maxX, m_minX};
+    return std::vector<double> {(double) m_maxLength, (double) m_minLength, (double) m_maxY, (double) m_minY, (double) m_maxX, (double) m_minX};
   }
   
+  // Retrieves constant reference to the series held in the container
+  const std::vector<NumericVector<T>>& getVector() const { return m_vec; }
+
   void print(std::ostream& os) const {
     for ( auto it = m_vec.begin(); it != m_vec.end(); it++ ) {
       (*it).print(os);
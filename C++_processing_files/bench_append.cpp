@@ -0,0 +1,44 @@
+// Benchmark for incremental appends to a VectorOfNumericVectors after Concatenate().
+// Appends N short series one at a time for increasing N and reports the total time and the
+// cost per append; with in-place appends the per-append cost should stay flat as N grows.
+// Usage: bench_append [largest N]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "NumericVector.h"
+#include "VectorOfNumericVectors.h"
+
+int main(int argc, char* argv[])
+{
+  int largest = argc > 1 ? std::atoi(argv[1]) : 256000;
+
+  std::mt19937 gen(7);
+  std::vector<NumericVector<int>> series;
+  for ( int s = 0; s < largest; s++ ) {
+    int length = 1 + gen() % 12;
+    std::vector<int> y(length), x(length);
+    for ( int j = 0; j < length; j++ ) {
+      y[j] = gen() % 25;
+      x[j] = gen() % 24;
+    }
+    series.push_back(NumericVector<int>(y, x));
+  }
+
+  for ( int n = 1000; n <= largest; n *= 2 ) {
+    VectorOfNumericVectors<int> set;
+    set.AddToVector(series[0]);
+    set.Concatenate();
+    auto start = std::chrono::steady_clock::now();
+    for ( int s = 1; s < n; s++ ) {
+      set.AddToVector(series[s]);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "N = " << n << ": total " << elapsed.count() << " s, "
+	      << 1e9*elapsed.count()/n << " ns/append, concatenated length "
+	      << set.getConcatenated().length << std::endl;
+  }
+}
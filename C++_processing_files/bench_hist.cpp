@@ -0,0 +1,133 @@
+// Per-point binning benchmark for Hist2D::addToHist.
+// Compares the original per-point std::lower_bound lookup against the current addToHist
+// for every Alignment on a fixed set of synthetic rank series and reports ns/point.
+// Also compares five separate addToHist passes against one Hist2DBank holding all five alignments,
+// and per-group histograms held as std::unique_ptr<Hist2D<int>> (as GroupAggregator does) against
+// an array of FixedHist2D with the same bins.
+// Usage: bench_hist [series] [repetitions]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "NumericVector.h"
+#include "Hist2D.h"
+#include "Hist2DBank.h"
+#include "FixedHist2D.h"
+
+typedef Hist2D<int>::Alignment Alignment;
+
+// The grid of the benchmarks below, fixed at compile time
+struct BenchGrid {
+  static constexpr int xBins = 40;
+  static constexpr int yBins = 25;
+  static constexpr double xMin = -.1, xMax = 40.1, yMin = -.1, yMax = 25.1;
+};
+
+// The lookup addToHist used before the arithmetic fast path, one binary search per coordinate
+void legacyAdd(boost::multi_array<int, 2>& counts, const std::vector<double>& xVals, const std::vector<double>& yVals,
+	       const NumericVector<int>& numVector, Alignment alignment) {
+  const std::vector<int>& toAddY = numVector.getYConst();
+  const std::vector<int>& toAddX = numVector.getXConst();
+  int n = toAddY.size();
+  int shape0 = counts.shape()[0];
+  int start = 0;
+  if ( alignment == Alignment::Back )  start = shape0 - n;
+  if ( alignment == Alignment::AtMax ) start = shape0/2 - (std::find(toAddY.begin(), toAddY.end(), numVector.m_maxY) - toAddY.begin());
+  if ( alignment == Alignment::AtMin ) start = shape0/2 - (std::find(toAddY.begin(), toAddY.end(), numVector.m_minY) - toAddY.begin());
+  for ( int j = 0; j < n; j++ ) {
+    double x = alignment == Alignment::ByX ? toAddX[j] : start + j;
+    int xInd = std::lower_bound(xVals.begin(), xVals.end(), x) - xVals.begin() - 1;
+    int yInd = std::lower_bound(yVals.begin(), yVals.end(), toAddY[j]) - yVals.begin() - 1;
+    counts[yInd][xInd] += 1;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  int seriesCount = argc > 1 ? std::atoi(argv[1]) : 200000;
+  int reps        = argc > 2 ? std::atoi(argv[2]) : 5;
+
+  // Rank series of length 1-12 in [0, 24] with hour-of-day x values, as in the Reddit data.
+  // The grid is wide enough that every alignment stays inside it.
+  std::mt19937 gen(42);
+  std::vector<NumericVector<int>> series;
+  long points = 0;
+  for ( int s = 0; s < seriesCount; s++ ) {
+    int length = 1 + gen() % 12;
+    std::vector<int> y(length), x(length);
+    for ( int j = 0; j < length; j++ ) {
+      y[j] = gen() % 25;
+      x[j] = (s + j) % 24;
+    }
+    series.push_back(NumericVector<int>(y, x));
+    points += length;
+  }
+
+  const char* names[] = {"Front", "Back", "AtMax", "AtMin", "ByX"};
+  Alignment alignments[] = {Alignment::Front, Alignment::Back, Alignment::AtMax, Alignment::AtMin, Alignment::ByX};
+  for ( int a = 0; a < 5; a++ ) {
+    double bestLegacy = 1e300, bestNew = 1e300;
+    for ( int r = 0; r < reps; r++ ) {
+      Hist2D<int> hist(40, 25, -.1, 40.1);
+      boost::multi_array<int, 2> counts(boost::extents[25][40]);
+      auto start = std::chrono::steady_clock::now();
+      for ( auto& s: series ) legacyAdd(counts, hist.getXEdges(), hist.getYEdges(), s, alignments[a]);
+      std::chrono::duration<double> legacy = std::chrono::steady_clock::now() - start;
+      start = std::chrono::steady_clock::now();
+      for ( auto& s: series ) hist.addToHist(s, alignments[a]);
+      std::chrono::duration<double> fast = std::chrono::steady_clock::now() - start;
+      bestLegacy = std::min(bestLegacy, legacy.count());
+      bestNew    = std::min(bestNew, fast.count());
+    }
+    std::cout << names[a] << ": lower_bound " << 1e9*bestLegacy/points << " ns/point, addToHist "
+	      << 1e9*bestNew/points << " ns/point (" << bestLegacy/bestNew << "x)" << std::endl;
+  }
+
+  double bestSeparate = 1e300, bestBank = 1e300;
+  for ( int r = 0; r < reps; r++ ) {
+    std::vector<Hist2D<int>> hists(5, Hist2D<int>(40, 25, -.1, 40.1));
+    Hist2DBank<int, int, Alignment::Front, Alignment::Back, Alignment::AtMax, Alignment::AtMin, Alignment::ByX> bank(40, 25, -.1, 40.1);
+    auto start = std::chrono::steady_clock::now();
+    for ( auto& s: series ) {
+      for ( int a = 0; a < 5; a++ ) hists[a].addToHist(s, alignments[a]);
+    }
+    std::chrono::duration<double> separate = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for ( auto& s: series ) bank.addToHist(s);
+    std::chrono::duration<double> banked = std::chrono::steady_clock::now() - start;
+    bestSeparate = std::min(bestSeparate, separate.count());
+    bestBank     = std::min(bestBank, banked.count());
+  }
+  std::cout << "All five: separate addToHist " << 1e9*bestSeparate/points << " ns/point, Hist2DBank "
+	    << 1e9*bestBank/points << " ns/point (" << bestSeparate/bestBank << "x)" << std::endl;
+
+  // Series spread round-robin over a few hundred groups, one Front histogram each
+  const int groups = 300;
+  double bestDynamic = 1e300, bestFixed = 1e300;
+  bool same = true;
+  for ( int r = 0; r < reps; r++ ) {
+    std::vector<std::unique_ptr<Hist2D<int>>> dynamic;
+    for ( int g = 0; g < groups; g++ ) dynamic.push_back(std::unique_ptr<Hist2D<int>>(new Hist2D<int>(40, 25, -.1, 40.1)));
+    std::vector<FixedHist2D<int, BenchGrid>> fixed(groups);
+    auto start = std::chrono::steady_clock::now();
+    for ( std::size_t s = 0; s < series.size(); s++ ) dynamic[s % groups]->addToHist(series[s], Alignment::Front);
+    std::chrono::duration<double> dynamicTime = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for ( std::size_t s = 0; s < series.size(); s++ ) fixed[s % groups].addToHist(series[s], Alignment::Front);
+    std::chrono::duration<double> fixedTime = std::chrono::steady_clock::now() - start;
+    bestDynamic = std::min(bestDynamic, dynamicTime.count());
+    bestFixed   = std::min(bestFixed, fixedTime.count());
+    for ( int g = 0; g < groups; g++ ) {
+      for ( int y = -1; y <= 25; y++ ) {
+	for ( int x = -1; x <= 40; x++ ) same = same && dynamic[g]->getCount(y, x) == fixed[g].getCount(y, x);
+      }
+    }
+  }
+  std::cout << groups << " groups: Hist2D " << 1e9*bestDynamic/points << " ns/point, FixedHist2D "
+	    << 1e9*bestFixed/points << " ns/point (" << bestDynamic/bestFixed << "x)"
+	    << (same ? "" : ", COUNTS DIFFER") << std::endl;
+}
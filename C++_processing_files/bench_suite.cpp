@@ -0,0 +1,236 @@
+// Reproducible benchmark suite over synthetic ragged series (see SyntheticSeries.h).
+// Every benchmark prints one JSON object per line to stdout, e.g.
+//   {"bench":"tsv_parse","kind":"micro","points":4000000,"bytes":...,"seconds":...,"ns_per_point":...,"mb_per_s":...}
+// with the best time of the given number of repetitions, so results of different builds can be diffed or plotted.
+// Micro benchmarks time one step on data already in memory; macro benchmarks time the demo's whole
+// file-to-output path. bytes is the input parsed or the output written, or the size of the series in memory.
+// Usage: bench_suite [points] [repetitions]
+//        bench_suite --generate output.tsv points [groups] [mean length]   writes a synthetic scrape file and exits
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <iostream>
+
+#include <unistd.h>
+
+#include "NumericVector.h"
+#include "VectorOfNumericVectors.h"
+#include "FlatVectorOfNumericVectors.h"
+#include "Hist2D.h"
+#include "TSVReader.h"
+#include "GroupAggregator.h"
+#include "ShardedBuild.h"
+#include "StreamingPipeline.h"
+#include "TimeBuckets.h"
+#include "SyntheticSeries.h"
+
+typedef Hist2D<int>::Alignment Alignment;
+
+const TimeBuckets HOURS(5 * 3600);
+
+// Per-thread state of the sharded end-to-end build, as in demo.cpp
+struct HourShard
+{
+  GroupAggregator<int> groups = GroupAggregator<int>(15, 25, -.1, 15.1);
+  std::vector<int> hours;
+
+  void merge(HourShard& other) { groups.merge(other.groups); }
+};
+
+void report(const char* name, const char* kind, long long points, double bytes, double seconds) {
+  std::printf("{\"bench\":\"%s\",\"kind\":\"%s\",\"points\":%lld,\"bytes\":%.0f,\"seconds\":%.6g,"
+	      "\"ns_per_point\":%.4g,\"mb_per_s\":%.4g,\"compiler\":\"%s\"}\n",
+	      name, kind, points, bytes, seconds, 1e9 * seconds / points, bytes / 1e6 / seconds, __VERSION__);
+  std::fflush(stdout);
+}
+
+// Best wall time of reps runs of run(), each preceded by an untimed prepare()
+template <typename Prepare, typename Run>
+double bestOf(int reps, Prepare prepare, Run run) {
+  double best = 1e300;
+  for ( int r = 0; r < reps; r++ ) {
+    prepare();
+    auto start = std::chrono::steady_clock::now();
+    run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+double fileBytes(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  return file ? (double) file.tellg() : 0;
+}
+
+// Total size of the files a GroupAggregator wrote for its groups
+double outputBytes(const GroupAggregator<int>& groups, const std::string& dir, const char* suffix, bool traits) {
+  double bytes = 0;
+  for ( std::size_t id = 0; id < groups.getGroups().size(); id++ ) {
+    bytes += fileBytes(dir + groups.getGroups().key(id) + suffix);
+    if ( traits ) bytes += fileBytes(dir + groups.getGroups().key(id) + "_traits_.csv");
+  }
+  return bytes;
+}
+
+void removeOutput(const GroupAggregator<int>& groups, const std::string& dir) {
+  for ( std::size_t id = 0; id < groups.getGroups().size(); id++ ) {
+    std::remove((dir + groups.getGroups().key(id) + "_bench_.txt").c_str());
+    std::remove((dir + groups.getGroups().key(id) + "_bench_.h2b").c_str());
+    std::remove((dir + groups.getGroups().key(id) + "_traits_.csv").c_str());
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  if ( argc > 3 && std::string(argv[1]) == "--generate" ) {
+    SyntheticConfig config;
+    if ( argc > 4 ) config.groups = std::atoi(argv[4]);
+    if ( argc > 5 ) config.meanLength = std::atof(argv[5]);
+    std::FILE* out = std::fopen(argv[2], "w");
+    if ( out == nullptr ) {
+      std::cout << "Could not open output file " << argv[2] << std::endl;
+      return 1;
+    }
+    SyntheticSeries generator(config);
+    generator.writeTSV(out, std::atoll(argv[3]));
+    std::fclose(out);
+    return 0;
+  }
+
+  long long targetPoints = argc > 1 ? std::atoll(argv[1]) : 4000000;
+  int reps = argc > 2 ? std::atoi(argv[2]) : 3;
+
+  char dirTemplate[] = "/tmp/bench_suiteXXXXXX";
+  if ( mkdtemp(dirTemplate) == nullptr ) {
+    std::cout << "Could not create a temporary directory" << std::endl;
+    return 1;
+  }
+  std::string dir = std::string(dirTemplate) + "/";
+  std::string tsvName = dir + "input.tsv";
+
+  // Input file and the same series in memory, with x already converted to hours as the demo does.
+  // Series are at most 15 points long so they fit the demo's front-aligned grid.
+  SyntheticConfig config;
+  config.maxLength = 15;
+  {
+    std::FILE* out = std::fopen(tsvName.c_str(), "w");
+    SyntheticSeries(config).writeTSV(out, targetPoints);
+    std::fclose(out);
+  }
+  double tsvBytes = fileBytes(tsvName);
+
+  std::vector<std::vector<int>> ys, xs;
+  std::vector<int> groupOf;
+  long long points = 0;
+  {
+    SyntheticSeries generator(config);
+    std::vector<int> y, x;
+    while ( points < targetPoints ) {
+      groupOf.push_back(generator.next(y, x));
+      HOURS.hourOfDay(x.data(), x.size(), x.data());
+      ys.push_back(y);
+      xs.push_back(x);
+      points += y.size();
+    }
+  }
+  double seriesBytes = 2.0 * sizeof(int) * points;
+
+  // TSV parsing alone
+  long long checksum = 0;
+  double seconds = bestOf(reps, []{}, [&] {
+      TSVReader reader(tsvName);
+      reader.forEachRow<int>([&](const SeriesRow<int>& row) { checksum += row.ranks.size() + row.subreddit.size; });
+    });
+  report("tsv_parse", "micro", points, tsvBytes, seconds);
+
+  // NumericVector construction and traits
+  std::vector<NumericVector<int>> vectors;
+  seconds = bestOf(reps, [&] { vectors.clear(); vectors.reserve(ys.size()); }, [&] {
+      for ( std::size_t s = 0; s < ys.size(); s++ ) vectors.push_back(NumericVector<int>(ys[s], xs[s]));
+    });
+  report("numeric_vector_construct", "micro", points, seriesBytes, seconds);
+
+  std::vector<NumericVector<int>> fresh;
+  double traitsSum = 0;
+  seconds = bestOf(reps, [&] { fresh = vectors; }, [&] {
+      for ( auto& v: fresh ) traitsSum += v.getAllData()[8];
+    });
+  report("get_all_data", "micro", points, seriesBytes, seconds);
+
+  // Concatenation of every series into one
+  std::vector<VectorOfNumericVectors<int>> lists;
+  seconds = bestOf(reps, [&] {
+      lists.assign(1, VectorOfNumericVectors<int>());
+      for ( auto& v: vectors ) lists[0].AddToVector(v);
+    }, [&] { lists[0].Concatenate(); });
+  report("concatenate", "micro", points, seriesBytes, seconds);
+  lists.clear();
+
+  // addToHist for every alignment. The grid is wide enough that no alignment places a point outside it.
+  const char* names[] = {"add_to_hist_front", "add_to_hist_back", "add_to_hist_atmax", "add_to_hist_atmin", "add_to_hist_byx"};
+  Alignment alignments[] = {Alignment::Front, Alignment::Back, Alignment::AtMax, Alignment::AtMin, Alignment::ByX};
+  for ( int a = 0; a < 5; a++ ) {
+    Hist2D<int> hist(128, 25, -64.1, 64.1);
+    seconds = bestOf(reps, []{}, [&] {
+	for ( auto& v: vectors ) hist.addToHist(v, alignments[a]);
+      });
+    report(names[a], "micro", points, seriesBytes, seconds);
+  }
+
+  // Output writing for one aggregator holding every series
+  GroupAggregator<int> groups(15, 25, -.1, 15.1);
+  for ( std::size_t s = 0; s < vectors.size(); s++ ) {
+    groups.addSeries(SyntheticSeries::groupName(groupOf[s]), vectors[s]);
+  }
+  seconds = bestOf(reps, []{}, [&] { groups.write(dir, "_bench_"); });
+  report("write_text", "micro", points, outputBytes(groups, dir, "_bench_.txt", true), seconds);
+  seconds = bestOf(reps, []{}, [&] { groups.writeBinary(dir, "_bench_"); });
+  report("write_binary", "micro", points, outputBytes(groups, dir, "_bench_.h2b", false), seconds);
+  removeOutput(groups, dir);
+  vectors.clear();
+  fresh.clear();
+
+  // The demo's two end-to-end paths, from input file to output files
+  unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+  auto hourSeries = [](HourShard& state, const SeriesRow<int>& row) {
+    if ( row.ranks.empty() ) return;
+    state.hours.resize(row.recordedAt.size());
+    HOURS.hourOfDay(row.recordedAt.data(), row.recordedAt.size(), state.hours.data());
+    NumericSeriesView<int> series = seriesView(row.ranks, state.hours);
+    state.groups.addSeries(row.subreddit, series);
+  };
+  seconds = bestOf(reps, []{}, [&] {
+      TSVReader reader(tsvName);
+      HourShard result = buildSharded<int, HourShard>(reader, threads, [] { return HourShard(); }, hourSeries);
+      result.groups.write(dir, "_bench_");
+    });
+  report("end_to_end_sharded", "macro", points, tsvBytes, seconds);
+
+  seconds = bestOf(reps, []{}, [&] {
+      GroupAggregator<int> result(15, 25, -.1, 15.1);
+      result.streamTraits(dir);
+      std::vector<int> hours;
+      streamSeries<int>(tsvName,
+	[&hours](const SeriesRow<int>& row, SeriesBatch<int>& batch) {
+	  hours.resize(row.recordedAt.size());
+	  HOURS.hourOfDay(row.recordedAt.data(), row.recordedAt.size(), hours.data());
+	  batch.add(row.subreddit, row.ranks, hours);
+	},
+	[&result](const std::string& key, NumericSeriesView<int>& series) { result.addSeries(key, series); });
+      result.write(dir, "_bench_");
+    });
+  report("end_to_end_stream", "macro", points, tsvBytes, seconds);
+
+  removeOutput(groups, dir);
+  std::remove(tsvName.c_str());
+  rmdir(dirTemplate);
+  // Keeps the results of the timed loops observable so they cannot be optimized away
+  if ( checksum == 42 && traitsSum == 42 ) std::printf("\n");
+  return 0;
+}
@@ -0,0 +1,99 @@
+// Throughput benchmark for TSV ingestion.
+// Compares the original getline/istringstream/substr/atoi loop from demo.cpp against the
+// memory-mapped TSVReader on the same file and reports MB/s for each.
+// Usage: bench_tsv [file.tsv] [repetitions]
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "TSVReader.h"
+
+// The tokenizing loop demo.cpp used before TSVReader, minus the histogram work.
+// Returns a checksum of everything parsed so the work cannot be optimized away.
+long long legacyParse(const std::string& filename) {
+  std::ifstream infile(filename);
+  std::string line;
+  bool first(true);
+  int column_counter = 0;
+  long long checksum = 0;
+  std::vector<int> stringvec1, stringvec2;
+  std::string keyString;
+  while ( std::getline(infile, line) ) {
+    std::string i;
+    std::istringstream iss(line);
+    while ( iss >> i ) {
+      if ( column_counter == 2 ) keyString = i;
+      column_counter++;
+      if ( i.at(0) == '[' ) {
+	std::vector<int>& target = first ? stringvec1 : stringvec2;
+	target.clear();
+	if ( i.back() == ']' ) {
+	  target.push_back(std::atoi(i.substr(1, i.length() - 1).c_str()));
+	} else {
+	  target.push_back(std::atoi(i.substr(1, i.length() - 1).c_str()));
+	  iss >> i;
+	  while ( i.back() != ']' ) {
+	    target.push_back(std::atoi(i.c_str()));
+	    iss >> i;
+	  }
+	  target.push_back(std::atoi(i.substr(0, i.length()-1).c_str()));
+	}
+	if ( !first ) {
+	  for ( unsigned int k = 0; k < stringvec1.size(); k++ ) checksum += stringvec1[k];
+	  for ( unsigned int k = 0; k < stringvec2.size(); k++ ) checksum += stringvec2[k];
+	  checksum += keyString.size();
+	}
+	first = !first;
+      }
+    }
+    column_counter = 0;
+  }
+  return checksum;
+}
+
+long long mappedParse(const std::string& filename) {
+  TSVReader reader(filename);
+  long long checksum = 0;
+  reader.forEachRow<int>([&](const SeriesRow<int>& row) {
+      for ( unsigned int k = 0; k < row.ranks.size(); k++ ) checksum += row.ranks[k];
+      for ( unsigned int k = 0; k < row.recordedAt.size(); k++ ) checksum += row.recordedAt[k];
+      checksum += row.subreddit.size;
+    });
+  return checksum;
+}
+
+template <typename F>
+void report(const std::string& name, F parse, const std::string& filename, double megabytes, int reps) {
+  double best = 1e300;
+  long long checksum = 0;
+  for ( int r = 0; r < reps; r++ ) {
+    auto start = std::chrono::steady_clock::now();
+    checksum = parse(filename);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  std::cout << name << ": " << megabytes / best << " MB/s"
+	    << " (best of " << reps << ", " << best << " s, checksum " << checksum << ")" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+  std::string filename = argc > 1 ? argv[1] : "../data/data.tsv";
+  int reps = argc > 2 ? std::atoi(argv[2]) : 3;
+
+  std::ifstream probe(filename, std::ios::binary | std::ios::ate);
+  if ( !probe ) {
+    std::cout << "Could not open input file " << filename << std::endl;
+    return 1;
+  }
+  double megabytes = probe.tellg() / 1e6;
+  std::cout << filename << ": " << megabytes << " MB" << std::endl;
+
+  report("istringstream loop", legacyParse, filename, megabytes, reps);
+  report("TSVReader (mmap)  ", mappedParse, filename, megabytes, reps);
+}
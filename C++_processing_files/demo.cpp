@@ -3,137 +3,192 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <memory>
+#include <iterator>
+#include <thread>
 
 
 
 #include "NumericVector.h"
 #include "VectorOfNumericVectors.h"
+#include "FlatVectorOfNumericVectors.h"
 #include "Hist2D.h"
+#include "TSVReader.h"
+#include "GroupAggregator.h"
+#include "ShardedBuild.h"
+#include "StreamingPipeline.h"
+#include "TimeBuckets.h"
+#include "Instrumentation.h"
+#include "HistDistance.h"
+#include "HistDensity.h"
+#include "Snapshot.h"
 
 const std::string FILENAME_COMPONENT = "_front_";
 
-template <typename T>
-void print(std::ostream& os, const std::vector<T>& v) {
-  std::copy(v.begin(), v.end(),
-	    std::ostream_iterator<T>(os, ","));
-  os << std::endl;
-}
-
 // Specific to the data file of Reddit rankings
-// Returns the UTC hour corresponding to input timestamp input as time since epoch
-int getHour(int timestamp){
-  time_t t = time_t(timestamp);
-  struct tm *tm = gmtime(&t);
-  char date[3];
-  strftime(date, sizeof(date), "%H", tm);
-  int result = std::atoi(date);
-  result = (result + 5) % 24;
-  return result;
+// Recorded times are shifted by +5 hours before taking the hour of the day
+const TimeBuckets REDDIT_HOURS(5 * 3600);
+
+// Saves the Jensen-Shannon distances between the histograms of all subreddits,
+// for clustering them in R with read_distance_binary. Returns false if the file could not be written.
+bool writeDistances(const GroupAggregator<int>& subjects, const std::string& outputDir)
+{
+  DistanceMatrix distances = groupDistances(subjects, HistMetric::JensenShannon);
+  return writeDistanceMatrix(outputDir + "distances_js.h2m", distances.names, distances.values);
 }
 
-// make_unique defined manually because not available from compiler
-template<typename T, typename... Args>
-std::unique_ptr<T> make_unique(Args&&... args) {
-    return std::unique_ptr<T>(new T(std::forward<Args>(args)...));
+// Saves the histograms, traits, densities and distances in binary form.
+// Reports and returns false if any of the files could not be written.
+bool writeBinaryOutput(const GroupAggregator<int>& subjects, const std::string& outputDir)
+{
+  bool written = subjects.writeBinary(outputDir, FILENAME_COMPONENT);
+  written &= writeDensities(subjects, outputDir, FILENAME_COMPONENT);
+  written &= writeDistances(subjects, outputDir);
+  if ( !written ) std::cout << "Could not write binary output to " << outputDir << std::endl;
+  return written;
 }
 
-int main()
+GroupAggregator<int> makeAggregator()
 {
+  return GroupAggregator<int>(15, 25, -.1, 15.1);
+}
 
-  std::ifstream infile("../data/data.tsv");
-  std::string line;
-  bool first(true);
-  std::vector<std::vector<int> > vec;
-
-  std::map<std::string, std::unique_ptr<Hist2D<int>>> SubjectList;
-  std::map<std::string, std::vector<std::vector<double>>> SubjectTraits;
-  int column_counter = 0;
-
-  while ( std::getline(infile, line) ) {
-      std::vector<int> subvec;
-      std::string i, letter;
-      std::istringstream iss(line);
-      std::vector<int> stringvec1;
-      std::vector<int> stringvec2;
-      std::string keyString;
-
-      // Reads in info from data.tsv, where useful data is in columns
-      // 2 (reddit thread name), 3 (timestamp),
-      // 4 (ranks recorded for a given thread), 5 (time ranks recorded)
-      while (iss >> i) {
-	if ( column_counter == 2 ) {    // Column 2 contains name of subreddit to which a particular thread (row) belongs
-	    keyString = i;
-	    if ( !SubjectList.count(keyString) ) {
-	      SubjectList[keyString] = make_unique<Hist2D<int>>(15, 25, -.1, 15.1);
-	       SubjectTraits[keyString] = std::vector<std::vector<double>>(0);			   
-	    }
-	  }
-	  column_counter ++;
-	  // Two columns of interest start with "[" because they contain a list of values within the column
-	  if ( i.at(0) == '[' && first) {
-	    stringvec1.clear();
-	    if ( i.back() == ']' ) {	    
-	      stringvec1.push_back(std::atoi(i.substr(1, i.length() - 1).c_str()));
-	      first = false;
-	    } else {
-	      stringvec1.push_back(std::atoi(i.substr(1, i.length() - 1).c_str()));
-	      iss >> i;	
-	      while ( i.back() != ']' ) {
-		stringvec1.push_back(std::atoi(i.c_str()));
-		iss >> i;	
-	      }
-	      stringvec1.push_back(std::atoi(i.substr(0, i.length()-1).c_str()));
-	      first = false;
-	    }
-	  } else if ( i.at(0) == '[' && !first ) {
-	    stringvec2.clear();
-	    if ( i.back() == ']' ) {	    
-	      stringvec2.push_back(std::atoi(i.substr(1, i.length() - 1).c_str()));
-	      first = true;
-	    } else {
-	      stringvec2.push_back(std::atoi(i.substr(1, i.length() - 1).c_str()));
-	      iss >> i;	
-	      while ( i.back() != ']' ) {
-		stringvec2.push_back(std::atoi(i.c_str()));
-		iss >> i;	
-	      }
-	      stringvec2.push_back(std::atoi(i.substr(0, i.length()-1).c_str()));
-	      first = true;
-	    }
-	    std::transform(stringvec2.begin(), stringvec2.end(), stringvec2.begin(), getHour);
-
-	    // This shows how you can instantiate a NumericVector
-	    // Add its traits to a vector of vectors of doubles
-	    // and add its value to the corresponding 2d histogram
-	    NumericVector<int> newVector(stringvec1, stringvec2);
-	    std::vector<double> traitsVector = newVector.getAllData();
-	    SubjectTraits[keyString].push_back(traitsVector);
-	    SubjectList[keyString]->addToHist(newVector, Hist2D<int>::Alignment::Front);
-	    first = true;
-	  }	  
-	}
-      column_counter = 0; // Reset column counter before moving to next row of file
-    }
+// What each thread of the sharded build keeps: its histograms and traits,
+// and a buffer for the hours of the current row that is reused across rows
+struct ShardState
+{
+  GroupAggregator<int> subjects = makeAggregator();
+  std::vector<int> hours;
 
-  std::string filename;
-  std::ofstream myfile;
+  void merge(ShardState& other) { subjects.merge(other.subjects); }
+};
 
-  // Saves each histogram to a text file named for corresponding subreddit 
-  for ( const auto &subject: SubjectList ) {
-    filename = "../data/" + subject.first + FILENAME_COMPONENT + ".txt";
-    myfile.open (filename);
-    subject.second->print(myfile);
-    myfile.close();      
+// Adds the size of every group to the instrumentation summary, when built with HIST_INSTRUMENT
+void recordGroups(const GroupAggregator<int>& subjects)
+{
+#ifdef HIST_INSTRUMENT
+  for ( std::size_t id = 0; id < subjects.getGroups().size(); id++ ) {
+    INSTRUMENT_GROUP(subjects.getGroups().key(id), subjects.getSeriesCount(id), subjects.getPointCount(id));
   }
+#endif
+}
 
-  // For each Reddit thread in a given subreddit, saves the traits of that thread
-  for ( const auto &traits: SubjectTraits ) {
-    filename = "../data/" + traits.first + "_traits_.csv";
-    myfile.open (filename);      
-      for ( auto it = traits.second.begin(); it!=traits.second.end(); ++it ) {
-	print(myfile, *it);
+// Same output as main's default mode, but only the histograms stay in memory:
+// traits are appended to their files as they are produced
+int streamDemo(const std::string& inputName, const std::string& outputDir, bool binary)
+{
+  GroupAggregator<int> subjects = makeAggregator();
+  subjects.streamTraits(outputDir);
+  std::vector<int> hours;
+  // False if the file could not be opened, or if reading it failed partway
+  bool complete = streamSeries<int>(inputName,
+    [&hours](const SeriesRow<int>& row, SeriesBatch<int>& batch) {
+      if ( row.ranks.empty() ) return;
+      {
+	INSTRUMENT_SCOPE(TimeBucket);
+	hours.resize(row.recordedAt.size());
+	REDDIT_HOURS.hourOfDay(row.recordedAt.data(), row.recordedAt.size(), hours.data());
       }
-      myfile.close();
+      batch.add(row.subreddit, row.ranks, hours);
+    },
+    [&subjects](const std::string& subreddit, NumericSeriesView<int>& series) {
+      INSTRUMENT_POLL();
+      subjects.addSeries(subreddit, series);
+    });
+  if ( !complete ) {
+    std::cout << "Could not read input file " << inputName << std::endl;
+    return 1;
+  }
+  bool written = true;
+  if ( binary ) {
+    written = writeBinaryOutput(subjects, outputDir);
+  } else {
+    subjects.write(outputDir, FILENAME_COMPONENT);
+  }
+  recordGroups(subjects);
+  return written ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+  // Input file, output directory and number of worker threads can be overridden on the command line.
+  // Passing "stream" in place of the thread count processes the file with the streaming pipeline instead,
+  // in memory that does not grow with the size of the input.
+  // A fourth argument of "binary" saves results in the binary format of BinaryOutput.h rather than as text,
+  // along with smoothed densities ready for plotting (.h2d) and the matrix of distances between subreddits
+  // ("text" keeps the text output).
+  // A fifth argument names a snapshot file (see Snapshot.h). If it holds a snapshot of an earlier run over the
+  // same input, only the rows appended since are processed; either way the snapshot is updated afterwards.
+  // Snapshots are not used in "stream" mode.
+  // Built with HIST_INSTRUMENT (make demo_instrumented), a summary of time per stage is printed at exit or on SIGUSR1.
+  INSTRUMENT_SETUP();
+  std::string inputName = argc > 1 ? argv[1] : "../data/data.tsv";
+  std::string outputDir = argc > 2 ? argv[2] : "../data/";
+  bool binary = argc > 4 && std::string(argv[4]) == "binary";
+  std::string snapshotName = argc > 5 ? argv[5] : "";
+  if ( argc > 3 && std::string(argv[3]) == "stream" ) {
+    return streamDemo(inputName, outputDir, binary);
+  }
+  unsigned int threads  = argc > 3 ? std::atoi(argv[3]) : std::thread::hardware_concurrency();
+
+  TSVReader reader(inputName);
+  if ( !reader.isOpen() ) {
+    std::cout << "Could not open input file " << inputName << std::endl;
+    return 1;
+  }
+
+  // Each thread builds its own histograms and traits over a shard of the file,
+  // which are merged in file order once all threads finish
+  auto makeState = [] { return ShardState(); };
+  auto addRow = [](ShardState& state, const SeriesRow<int>& row) {
+    INSTRUMENT_POLL();
+    if ( row.ranks.empty() ) return;
+    std::vector<int>& hours = state.hours;
+    {
+      INSTRUMENT_SCOPE(TimeBucket);
+      hours.resize(row.recordedAt.size());
+      REDDIT_HOURS.hourOfDay(row.recordedAt.data(), row.recordedAt.size(), hours.data());
+    }
+
+    // This shows how you can view a row's ranks and hours as a series, without copying them,
+    // and add it to the 2d histogram and traits of the subreddit
+    // to which a particular thread (row) belongs.
+    // Any other key works the same way, e.g. ByComp()(row) or ByCreatedBucket(24 * 60)(row)
+    NumericSeriesView<int> series = [&] {
+      INSTRUMENT_SCOPE(Construct);
+      return seriesView(row.ranks, hours);
+    }();
+    state.subjects.addSeries(row.subreddit, series);
+  };
+
+  // Resumes from the snapshot when it matches the input, so only the new tail of the file is parsed.
+  // Rows of the tail are merged after those of the snapshot, giving the same output as a full run.
+  GroupAggregator<int> subjects = makeAggregator();
+  InputPosition position;
+  if ( !snapshotName.empty() && !(loadSnapshot(snapshotName, subjects, position) && position.matches(reader)) ) {
+    subjects = makeAggregator();
+    position = InputPosition();
+  }
+  std::size_t end = snapshotName.empty() ? reader.size() : reader.completeLinesEnd();
+  ShardState added = buildSharded<int, ShardState>(reader, threads, makeState, addRow, position.offset, end);
+  subjects.merge(added.subjects);
+  if ( !snapshotName.empty() ) {
+    std::size_t rows = 0;
+    for ( std::size_t id = 0; id < subjects.getGroups().size(); id++ ) rows += subjects.getSeriesCount(id);
+    if ( !saveSnapshot(snapshotName, subjects, InputPosition::at(reader, end, rows)) ) {
+      std::cout << "Could not write snapshot file " << snapshotName << std::endl;
+    }
+  }
+
+  // Saves each histogram to a text file named for corresponding subreddit
+  // and the traits of each Reddit thread to a file for its subreddit,
+  // or both together to one binary file per subreddit next to its smoothed density
+  bool written = true;
+  if ( binary ) {
+    written = writeBinaryOutput(subjects, outputDir);
+  } else {
+    subjects.write(outputDir, FILENAME_COMPONENT);
   }
+  recordGroups(subjects);
+  return written ? 0 : 1;
 }
- 
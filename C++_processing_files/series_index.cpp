@@ -0,0 +1,98 @@
+// Builds and queries a SeriesIndex (see SeriesIndex.h) over a Reddit scrape file, so new questions
+// about the data are answered from the index instead of a fresh pass over the TSV.
+// Usage:
+//   series_index build <file.tsv> <file.h2i>
+//   series_index query <file.h2i> [group=<subreddit>]... [from=<created>] [to=<created>]
+//                      [minlen=<n>] [maxlen=<n>] [align=front|back|atmax|atmin|byx]
+// A query prints the histogram of the matching series in the same text format as demo.cpp's output,
+// with the same bins (24 hourly x bins for align=byx), and reports the number of series matched
+// and the query time on stderr.
+// Created times are in the units of the created column, with from inclusive and to exclusive.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "TSVReader.h"
+#include "TimeBuckets.h"
+#include "SeriesIndex.h"
+
+// Same hour of day as demo.cpp: recorded times are shifted by +5 hours
+const TimeBuckets REDDIT_HOURS(5 * 3600);
+
+int build(const std::string& inputName, const std::string& indexName)
+{
+  TSVReader reader(inputName);
+  if ( !reader.isOpen() ) {
+    std::cout << "Could not open input file " << inputName << std::endl;
+    return 1;
+  }
+  SeriesIndexWriter<int> writer;
+  std::vector<int> hours;
+  reader.forEachRow<int>([&](const SeriesRow<int>& row) {
+    if ( row.ranks.empty() ) return;
+    hours.resize(row.recordedAt.size());
+    REDDIT_HOURS.hourOfDay(row.recordedAt.data(), row.recordedAt.size(), hours.data());
+    writer.add(row.subreddit, row.created, row.ranks.data(), hours.data(), row.ranks.size());
+  });
+  if ( !writer.write(indexName) ) {
+    std::cout << "Could not write index file " << indexName << std::endl;
+    return 1;
+  }
+  std::cerr << writer.size() << " series indexed" << std::endl;
+  return 0;
+}
+
+int query(const std::string& indexName, int argc, char* argv[])
+{
+  typedef Hist2DAlignment::Alignment Alignment;
+  SeriesIndex<int> index(indexName);
+  if ( !index.isOpen() ) {
+    std::cout << "Could not open index file " << indexName << std::endl;
+    return 1;
+  }
+  SeriesQuery filter;
+  Alignment alignment = Alignment::Front;
+  for ( int i = 0; i < argc; i++ ) {
+    std::string arg = argv[i];
+    std::size_t equals = arg.find('=');
+    std::string name  = arg.substr(0, equals);
+    std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+    if ( name == "group" ) filter.group(value);
+    else if ( name == "from" ) filter.createdFrom = std::atoll(value.c_str());
+    else if ( name == "to" ) filter.createdTo = std::atoll(value.c_str());
+    else if ( name == "minlen" ) filter.lengthMin = std::atoi(value.c_str());
+    else if ( name == "maxlen" ) filter.lengthMax = std::atoi(value.c_str());
+    else if ( name == "align" && value == "front" ) alignment = Alignment::Front;
+    else if ( name == "align" && value == "back" ) alignment = Alignment::Back;
+    else if ( name == "align" && value == "atmax" ) alignment = Alignment::AtMax;
+    else if ( name == "align" && value == "atmin" ) alignment = Alignment::AtMin;
+    else if ( name == "align" && value == "byx" ) alignment = Alignment::ByX;
+    else {
+      std::cout << "Unknown query argument " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  // Index alignments use demo.cpp's bins; ByX gets one x bin per hour of the day
+  Hist2D<int> hist = alignment == Alignment::ByX ? Hist2D<int>(24, 25, -.1, 23.9) : Hist2D<int>(15, 25, -.1, 15.1);
+  std::size_t matched = index.addToHist(hist, filter, alignment);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  hist.print(std::cout);
+  std::cerr << matched << " of " << index.size() << " series matched in " << seconds << " s" << std::endl;
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  std::string command = argc > 1 ? argv[1] : "";
+  if ( command == "build" && argc == 4 ) return build(argv[2], argv[3]);
+  if ( command == "query" && argc >= 3 ) return query(argv[2], argc - 3, argv + 3);
+  std::cout << "Usage: series_index build <file.tsv> <file.h2i>" << std::endl;
+  std::cout << "       series_index query <file.h2i> [group=<subreddit>]... [from=<created>] [to=<created>]"
+	    << " [minlen=<n>] [maxlen=<n>] [align=front|back|atmax|atmin|byx]" << std::endl;
+  return 1;
+}
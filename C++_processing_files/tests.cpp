@@ -0,0 +1,444 @@
+// Checks of the histogram code against simple reference computations, built and run by `make tests`.
+// Each check that fails prints its file, line and condition; the program exits with status 1 if any failed.
+// Temporary files are written to a fresh directory under /tmp and removed afterwards.
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <algorithm>
+
+#include <unistd.h>
+
+#include "NumericVector.h"
+#include "FlatVectorOfNumericVectors.h"
+#include "Hist2D.h"
+#include "Hist2DBank.h"
+#include "FixedHist2D.h"
+#include "RollingHist2D.h"
+#include "QuantileSketch.h"
+#include "HistDensity.h"
+#include "BinaryOutput.h"
+#include "Snapshot.h"
+#include "GroupAggregator.h"
+#include "SeriesIndex.h"
+#include "SeriesStats.h"
+#include "TSVReader.h"
+#include "TimeBuckets.h"
+#include "SyntheticSeries.h"
+
+typedef Hist2D<int>::Alignment Alignment;
+
+const Alignment ALIGNMENTS[] = {Alignment::Front, Alignment::Back, Alignment::AtMax, Alignment::AtMin, Alignment::ByX};
+const OutOfRangeMode MODES[] = {OutOfRangeMode::Drop, OutOfRangeMode::Clamp};
+
+int failures = 0;
+std::string tempDir;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+void check(bool ok, const char* condition, const char* file, int line) {
+  if ( ok ) return;
+  failures++;
+  std::cout << file << ":" << line << ": check failed: " << condition << std::endl;
+}
+
+// The demo's 15 x 25 layout, fixed at compile time for FixedHist2D
+struct DemoGeometry
+{
+  static constexpr int xBins = 15;
+  static constexpr int yBins = 25;
+  static constexpr double xMin = -.1;
+  static constexpr double xMax = 15.1;
+  static constexpr double yMin = -.1;
+  static constexpr double yMax = 25.1;
+};
+constexpr int DemoGeometry::xBins;
+constexpr int DemoGeometry::yBins;
+constexpr double DemoGeometry::xMin;
+constexpr double DemoGeometry::xMax;
+constexpr double DemoGeometry::yMin;
+constexpr double DemoGeometry::yMax;
+
+Hist2D<int> demoHist() { return Hist2D<int>(15, 25, -.1, 15.1, -.1, 25.1); }
+
+// Synthetic series with x converted to hours of the day as the demo does. Ranks run up to 29,
+// so some points fall above the 25 y bins, and hours past 15 fall beyond the x bins of ByX.
+struct Generated
+{
+  FlatVectorOfNumericVectors<int> series;
+  std::vector<int> groups;
+  std::vector<long long> created;
+};
+
+Generated generate(int count, std::uint64_t seed) {
+  SyntheticConfig config;
+  config.seed = seed;
+  config.valueDomain = 30;
+  config.groups = 10;
+  SyntheticSeries source(config);
+  TimeBuckets hours(5 * 3600);
+  Generated generated;
+  std::vector<int> y, x;
+  for ( int i = 0; i < count; i++ ) {
+    generated.groups.push_back(source.next(y, x));
+    generated.created.push_back(source.created());
+    for ( auto& stamp: x ) stamp = hours.hourOfDay(stamp);
+    generated.series.AddToVector(y, x);
+  }
+  return generated;
+}
+
+// Equal counts in every bin including the guard bins, and equal out-of-range counters
+template <typename A, typename B>
+bool sameCounts(const A& a, const B& b) {
+  if ( a.getXBins() != b.getXBins() || a.getYBins() != b.getYBins() ) return false;
+  for ( int y = -1; y <= a.getYBins(); y++ ) {
+    for ( int x = -1; x <= a.getXBins(); x++ ) {
+      if ( a.getCount(y, x) != b.getCount(y, x) ) return false;
+    }
+  }
+  return a.getDroppedPoints() == b.getDroppedPoints() && a.getClampedPoints() == b.getClampedPoints();
+}
+
+// Sums of the counts inside the bins and in the guard bins around them
+template <typename Hist>
+void countTotals(const Hist& hist, double& inside, double& guards) {
+  inside = guards = 0;
+  for ( int y = -1; y <= hist.getYBins(); y++ ) {
+    for ( int x = -1; x <= hist.getXBins(); x++ ) {
+      bool guard = y < 0 || x < 0 || y == hist.getYBins() || x == hist.getXBins();
+      (guard ? guards : inside) += hist.getCount(y, x);
+    }
+  }
+}
+
+bool sameCurve(const std::vector<double>& a, const std::vector<double>& b) {
+  if ( a.size() != b.size() ) return false;
+  for ( std::size_t i = 0; i < a.size(); i++ ) {
+    if ( !(a[i] == b[i] || (std::isnan(a[i]) && std::isnan(b[i]))) ) return false;
+  }
+  return true;
+}
+
+void testGuardBins() {
+  // y = -5 and 30 are outside the y bins, and a Front series of 20 points runs past the 15 x bins at positions 16 to 19
+  NumericVector<int> outside(std::vector<int>{-5, 3, 30, 7}, std::vector<int>{0, 1, 2, 3});
+  NumericVector<int> longSeries(std::vector<int>(20, 3), std::vector<int>(20, 0));
+
+  Hist2D<int> dropped = demoHist();
+  dropped.addToHist(outside, Alignment::Front);
+  CHECK(dropped.getDroppedPoints() == 2 && dropped.getClampedPoints() == 0);
+  CHECK(dropped.getCount(-1, 0) == 1 && dropped.getCount(25, 2) == 1);
+  CHECK(dropped.getCount(3, 1) == 1 && dropped.getCount(7, 3) == 1);
+  dropped.addToHist(longSeries, Alignment::Front);
+  double inside, guards;
+  countTotals(dropped, inside, guards);
+  CHECK(dropped.getDroppedPoints() == 6 && guards == 6 && inside == 18);
+  CHECK(dropped.getCount(3, 15) == 4);
+
+  Hist2D<int> clamped = demoHist();
+  clamped.setOutOfRangeMode(OutOfRangeMode::Clamp);
+  clamped.addToHist(outside, Alignment::Front);
+  CHECK(clamped.getClampedPoints() == 2 && clamped.getDroppedPoints() == 0);
+  CHECK(clamped.getCount(0, 0) == 1 && clamped.getCount(24, 2) == 1 && clamped.getCount(-1, 0) == 0);
+  clamped.addToHist(longSeries, Alignment::Front);
+  countTotals(clamped, inside, guards);
+  CHECK(clamped.getClampedPoints() == 6 && guards == 0 && inside == 24);
+  CHECK(clamped.getCount(3, 14) == 5);
+
+  // Non-finite values have no bin to be clamped to and are always dropped
+  Hist2D<double> nonFinite(15, 25, -.1, 15.1, -.1, 25.1);
+  nonFinite.setOutOfRangeMode(OutOfRangeMode::Clamp);
+  nonFinite.addToHist(NumericVector<double>(std::vector<double>{NAN, 2, INFINITY, 4}, std::vector<double>{0, 1, 2, 3}),
+		      Alignment::Front);
+  CHECK(nonFinite.getDroppedPoints() == 2 && nonFinite.getClampedPoints() == 0);
+  CHECK(nonFinite.getCount(-1, 0) == 1 && nonFinite.getCount(-1, 2) == 1);
+  CHECK(nonFinite.getCount(2, 1) == 1 && nonFinite.getCount(4, 3) == 1);
+}
+
+void testBank(const Generated& generated) {
+  for ( OutOfRangeMode mode: MODES ) {
+    Hist2DBank<int, int, Alignment::Front, Alignment::Back, Alignment::AtMax, Alignment::AtMin, Alignment::ByX>
+      bank(15, 25, -.1, 15.1);
+    bank.setOutOfRangeMode(mode);
+    bank.trackQuantiles();
+    std::vector<Hist2D<int>> separate(5, demoHist());
+    for ( auto& hist: separate ) {
+      hist.setOutOfRangeMode(mode);
+      hist.trackQuantiles();
+    }
+    bank.addToHist(generated.series);
+    for ( int a = 0; a < 5; a++ ) separate[a].addToHist(generated.series, ALIGNMENTS[a]);
+
+    for ( int a = 0; a < 5; a++ ) {
+      const Hist2D<int>& fromBank = bank.get(ALIGNMENTS[a]);
+      CHECK(sameCounts(fromBank, separate[a]));
+      CHECK(sameCurve(fromBank.getQuantileCurve(.5), separate[a].getQuantileCurve(.5)));
+      CHECK(sameCurve(fromBank.getQuantileCurve(.9), separate[a].getQuantileCurve(.9)));
+    }
+  }
+}
+
+void testFixedHist(const Generated& generated) {
+  for ( OutOfRangeMode mode: MODES ) {
+    for ( Alignment alignment: ALIGNMENTS ) {
+      FixedHist2D<int, DemoGeometry> fixed;
+      Hist2D<int> dynamic = demoHist();
+      fixed.setOutOfRangeMode(mode);
+      dynamic.setOutOfRangeMode(mode);
+      fixed.addToHist(generated.series, alignment);
+      dynamic.addToHist(generated.series, alignment);
+      CHECK(sameCounts(fixed, dynamic));
+      CHECK(sameCounts(fixed.toHist2D(), dynamic));
+    }
+  }
+}
+
+void testRolling(const Generated& generated) {
+  // Window of 3 slides of one time unit; series i is observed at time i / 50
+  const int perSlice = 50, window = 3;
+  RollingHist2D<int> rolling(window, 1, 15, 25, -.1, 15.1);
+  for ( std::size_t i = 0; i < generated.series.size() && i < 10 * perSlice; i++ ) {
+    long long time = i / perSlice;
+    CHECK(rolling.addToHist(time, generated.series[i], Alignment::Front));
+    if ( (i + 1) % perSlice != 0 ) continue;
+
+    // The window holds exactly the series of its last three slices
+    Hist2D<int> expected = demoHist();
+    for ( std::size_t j = 0; j <= i; j++ ) {
+      if ( (long long) (j / perSlice) > time - window ) expected.addToHist(generated.series[j], Alignment::Front);
+    }
+    CHECK(sameCounts(rolling.window(), expected));
+    CHECK(rolling.windowStart() == time - window + 1 && rolling.windowEnd() == time + 1);
+    if ( time >= window ) CHECK(!rolling.addToHist(time - window, generated.series[0], Alignment::Front));
+  }
+  rolling.advanceTo(100);
+  double inside, guards;
+  countTotals(rolling.window(), inside, guards);
+  CHECK(inside == 0 && guards == 0);
+  CHECK(rolling.window().getDroppedPoints() == 0);
+}
+
+void testQuantileSketch() {
+  // A shuffled 0 .. n-1, whose true rank of value v is v / n
+  const int n = 100000, k = 200;
+  std::vector<double> values(n);
+  for ( int i = 0; i < n; i++ ) values[i] = i;
+  SplitMix64 random(7);
+  for ( int i = n - 1; i > 0; i-- ) std::swap(values[i], values[random.below(i + 1)]);
+
+  QuantileSketch<double> whole(k), firstHalf(k), secondHalf(k);
+  for ( int i = 0; i < n; i++ ) {
+    whole.add(values[i]);
+    (i < n / 2 ? firstHalf : secondHalf).add(values[i]);
+  }
+  firstHalf.merge(secondHalf);
+  CHECK(whole.count() == (std::uint64_t) n && firstHalf.count() == (std::uint64_t) n);
+  CHECK(whole.min() == 0 && whole.max() == n - 1);
+
+  // KLL's normalized rank error is about 1.7 / k with high probability
+  const double bound = 3.0 / k;
+  for ( double q: {.01, .05, .1, .25, .5, .75, .9, .95, .99} ) {
+    CHECK(std::fabs(whole.quantile(q) / n - q) <= bound);
+    CHECK(std::fabs(firstHalf.quantile(q) / n - q) <= bound);
+  }
+  CHECK(whole.retained() < 10 * (std::size_t) k);
+}
+
+void testDensity(const Generated& generated) {
+  Hist2D<int> hist = demoHist();
+  hist.addToHist(generated.series, Alignment::Front);
+  double inside, guards;
+  countTotals(hist, inside, guards);
+  double seriesCount = generated.series.size();
+
+  for ( DensityKernel kernel: {DensityKernel::None, DensityKernel::Gaussian, DensityKernel::Epanechnikov} ) {
+    // Smoothing moves mass between bins but keeps all of it inside the grid
+    DensityGrid global = HistDensity(DensityOptions(kernel, 1.5, 2)).compute(hist);
+    double sum = 0;
+    for ( float v: global.values ) sum += v;
+    CHECK(global.total == inside);
+    CHECK(std::fabs(sum - 1) < 1e-4);
+
+    DensityGrid perSeries = HistDensity(DensityOptions(kernel, 1.5, 2, DensityNormalization::PerSeries)).compute(hist, seriesCount);
+    sum = 0;
+    for ( float v: perSeries.values ) sum += v;
+    CHECK(std::fabs(sum * seriesCount / inside - 1) < 1e-4);
+  }
+}
+
+void testSnapshot(const Generated& generated) {
+  GroupAggregator<int> groups(15, 25, -.1, 15.1);
+  for ( std::size_t i = 0; i < generated.series.size(); i++ ) {
+    NumericSeriesView<int> view = generated.series[i];
+    groups.addSeries(SyntheticSeries::groupName(generated.groups[i]), view);
+  }
+  InputPosition position;
+  position.offset = 123;
+  position.rows = 45;
+  position.fingerprint = 678;
+  std::string filename = tempDir + "state.h2ds";
+  CHECK(saveSnapshot(filename, groups, position));
+
+  GroupAggregator<int> restored(15, 25, -.1, 15.1);
+  InputPosition loaded;
+  CHECK(loadSnapshot(filename, restored, loaded));
+  CHECK(loaded.offset == 123 && loaded.rows == 45 && loaded.fingerprint == 678);
+  CHECK(restored.getGroups().size() == groups.getGroups().size());
+  for ( std::size_t id = 0; id < groups.getGroups().size(); id++ ) {
+    int other = restored.groupId(groups.getGroups().key(id));
+    CHECK(sameCounts(restored.getHistogram(other), groups.getHistogram(id)));
+    CHECK(restored.getSeriesCount(other) == groups.getSeriesCount(id));
+    CHECK(restored.getPointCount(other) == groups.getPointCount(id));
+    CHECK(restored.getTraits(other) == groups.getTraits(id));
+  }
+
+  // A snapshot taken with other bins is refused and leaves the aggregator as it was
+  GroupAggregator<int> otherBins(16, 25, -.1, 15.1);
+  CHECK(!loadSnapshot(filename, otherBins, loaded));
+  CHECK(otherBins.getGroups().size() == 0);
+  std::remove(filename.c_str());
+}
+
+void testBinary(const Generated& generated) {
+  Hist2D<int> hist = demoHist();
+  std::vector<std::vector<double>> traits;
+  for ( std::size_t i = 0; i < 100; i++ ) {
+    hist.addToHist(generated.series[i], Alignment::AtMax);
+    traits.push_back(generated.series[i].getAllData());
+  }
+  std::string filename = tempDir + "group.h2b";
+  CHECK(writeBinary(filename, hist, traits));
+
+  std::ifstream file(filename, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  SnapshotReader in(bytes.data(), bytes.size());
+  CHECK(in.bytes(4).str() == "H2DB");
+  CHECK(in.u32() == BINARY_FORMAT_VERSION);
+  CHECK(in.u32() == 15 && in.u32() == 25);
+  for ( double edge: hist.getXEdges() ) CHECK(in.f64() == edge);
+  for ( double edge: hist.getYEdges() ) CHECK(in.f64() == edge);
+  for ( int y = 0; y < 25; y++ ) {
+    for ( int x = 0; x < 15; x++ ) CHECK(in.f64() == hist.getCount(y, x));
+  }
+  CHECK(in.u64() == traits.size());
+  std::uint32_t columns = in.u32();
+  CHECK(columns == traits[0].size());
+  for ( std::uint32_t column = 0; column < columns; column++ ) {
+    for ( const auto& row: traits ) CHECK(in.f64() == row[column]);
+  }
+  CHECK(in.ok() && in.atEnd());
+  std::remove(filename.c_str());
+
+  // A write that cannot happen is reported
+  CHECK(!writeBinary(tempDir + "missing/group.h2b", hist, traits));
+}
+
+void testSeriesIndex(const Generated& generated) {
+  SeriesIndexWriter<int> writer;
+  for ( std::size_t i = 0; i < generated.series.size(); i++ ) {
+    NumericSeriesView<int> view = generated.series[i];
+    std::string key = SyntheticSeries::groupName(generated.groups[i]);
+    writer.add(FieldView(key.data(), key.size()), generated.created[i], view.getYData(), view.getXData(), view.length);
+  }
+  std::string filename = tempDir + "series.h2di";
+  CHECK(writer.write(filename));
+  SeriesIndex<int> index(filename);
+  CHECK(index.isOpen() && index.size() == generated.series.size());
+
+  long long from = generated.created[generated.created.size() / 4], to = generated.created[generated.created.size() * 3 / 4];
+  SeriesQuery query;
+  query.group("group3").group("group7").createdBetween(from, to).lengthBetween(2, 20).maxYBetween(5, 22);
+  for ( Alignment alignment: ALIGNMENTS ) {
+    // The same filter applied to every series in turn
+    Hist2D<int> expected = demoHist();
+    std::size_t expectedCount = 0;
+    for ( std::size_t i = 0; i < generated.series.size(); i++ ) {
+      NumericSeriesView<int> view = generated.series[i];
+      if ( generated.groups[i] != 3 && generated.groups[i] != 7 ) continue;
+      if ( generated.created[i] < from || generated.created[i] >= to ) continue;
+      if ( view.length < 2 || view.length > 20 || view.m_maxY < 5 || view.m_maxY > 22 ) continue;
+      expected.addToHist(view, alignment);
+      expectedCount++;
+    }
+    Hist2D<int> queried = demoHist();
+    CHECK(index.addToHist(queried, query, alignment) == expectedCount);
+    CHECK(expectedCount > 0 && sameCounts(queried, expected));
+  }
+
+  // Naming a group twice selects its series once
+  SeriesQuery repeated = query;
+  repeated.group("group3");
+  CHECK(index.forEach(repeated, [](const NumericSeriesView<int>&, int, long long) {}) ==
+	index.forEach(query, [](const NumericSeriesView<int>&, int, long long) {}));
+  std::remove(filename.c_str());
+}
+
+void testReader() {
+  // The second data row has three ranks but two timestamps and is skipped
+  std::string filename = tempDir + "rows.tsv";
+  std::ofstream file(filename);
+  file << "comp\tid\tsubreddit\tcreated\tranks\trecorded_at\trank_length\n"
+       << "0\ta\tpics\t1434000000.0\t[1, 2]\t[1434000100, 1434003700]\t2.0\n"
+       << "0\tb\tpics\t1434000000.0\t[1, 2, 3]\t[1434000100, 1434003700]\t3.0\n"
+       << "0\tc\tnews\t1434000000.0\t[4]\t[1434000100]\t1.0\n";
+  file.close();
+  TSVReader reader(filename);
+  std::vector<std::string> ids;
+  CHECK(reader.forEachRow<int>([&](const SeriesRow<int>& row) { ids.push_back(row.id.str()); }) == 2);
+  CHECK(ids == std::vector<std::string>({"a", "c"}));
+  std::remove(filename.c_str());
+}
+
+void testMisuse() {
+  Hist2D<int> tracked = demoHist(), untracked = demoHist(), otherBins(16, 25, -.1, 15.1, -.1, 25.1);
+  tracked.trackQuantiles();
+  bool threw = false;
+  try { tracked.merge(untracked); } catch ( const std::invalid_argument& ) { threw = true; }
+  CHECK(threw);
+  threw = false;
+  try { untracked.merge(otherBins); } catch ( const std::invalid_argument& ) { threw = true; }
+  CHECK(threw);
+
+  // Moments of 64-bit values far beyond what a square sum could hold
+  long long y[] = {4000000000000000000LL, 4000000000000000002LL, 4000000000000000004LL};
+  long long x[] = {0, 1, 2};
+  double result[9];
+  computeSeriesStats(y, x, 3, result);
+  CHECK(std::fabs(result[7] / 4e18 - 1) < 1e-12 && result[8] >= 0 && result[8] < 1e3);
+}
+
+int main() {
+  char dirTemplate[] = "/tmp/hist_testsXXXXXX";
+  if ( mkdtemp(dirTemplate) == nullptr ) {
+    std::cout << "Could not create a temporary directory" << std::endl;
+    return 1;
+  }
+  tempDir = std::string(dirTemplate) + "/";
+
+  Generated generated = generate(5000, 42);
+  testGuardBins();
+  testBank(generated);
+  testFixedHist(generated);
+  testRolling(generated);
+  testQuantileSketch();
+  testDensity(generated);
+  testSnapshot(generated);
+  testBinary(generated);
+  testSeriesIndex(generated);
+  testReader();
+  testMisuse();
+
+  rmdir(dirTemplate);
+  if ( failures != 0 ) {
+    std::cout << failures << " checks failed" << std::endl;
+    return 1;
+  }
+  std::cout << "All checks passed" << std::endl;
+  return 0;
+}
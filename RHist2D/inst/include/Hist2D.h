@@ -0,0 +1,652 @@
+#ifndef HIST_2D
+#define HIST_2D
+
+#include "VectorOfNumericVectors.h"
+#include "FlatVectorOfNumericVectors.h"
+#include "NumericVector.h"
+
+#include <ostream>
+#include <limits>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <cmath>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include <boost/multi_array.hpp>
+
+#include "TiledCounts.h"
+#include "QuantileSketch.h"
+#include "Instrumentation.h"
+
+
+// Hist2D can align histograms in a variety of ways
+// The alignment types live in a common base so every Hist2D instantiation shares one Alignment type
+struct Hist2DAlignment
+{
+  enum class Alignment {
+    // First four alignment types align all series according to indices of values rather than x dimension of series
+    // These provide ways to compare values at a particular part of a series ("beginning, end") rather than
+    // values relative to an actual x value such as time or displacement
+    Front, // Each series of y values is binned with x as index of y axis and all NumericVectors start at 1
+    Back,  // Each series of y values is binned with x as index of y axis and all NumericVectors end at last available x value in histogram 
+    AtMax, // Each series of y values is aligned within histogram such that the max value is at the center x value of the histogram
+    AtMin, // Each series of y values is aligned within histogram such that the min value is at the center x value of the histogram
+    // Fifth alignment type aligns along 'true' x value, so can show how value relates to other dimension, such as value vs. time or value vs. displacement
+    ByX    // Each series is aligned according to 'true' x value rather than index of y axis
+
+  };
+};
+
+// What Hist2D does with a point whose y value or x position falls outside the range of its bins
+enum class OutOfRangeMode {
+  Drop,  // The point is counted in a guard bin just outside the grid, and is left out of the histogram proper
+  Clamp  // The point is counted in the nearest bin at the edge of the grid
+};
+
+// Hist2D uses a Boost multi-array to store a two dimensional histogram 
+// Alignment of the histogram can be done by index of a vector or by the x-value accompanying each y-value
+// Hist2D can be computed on-the-fly with series added one at a time, or with a large number of series added together
+// The type of the bin counters, CountT, is independent of the series type T. Compact unsigned counters
+// (uint16_t, uint32_t) keep many histograms cache resident, uint64_t suits very large runs, and float or double
+// counters allow weighted counts. CountT defaults to T, which reproduces the original behaviour.
+// With setWidenOnOverflow(true), an integer counter that would overflow spills its count into a 64-bit side table,
+// so compact counters can be used without risking wrapped counts.
+// Grids with more than a million bins (e.g. minute-level x over weeks) are stored sparsely in tiles
+// allocated on first touch (see TiledCounts.h) instead of a dense multi-array; the interface is the same.
+// With trackQuantiles(), every x bin also keeps a QuantileSketch of the y values that land in it, so median
+// or percentile trajectories (e.g. the p90 rank per hour since entry) come out of the same single pass
+// without keeping the raw points.
+// Every grid is surrounded by one guard row and column on each side (underflow and overflow bins), so a point
+// outside the bins is never written out of bounds: it lands in a guard bin (OutOfRangeMode::Drop, the default)
+// or is moved onto the nearest edge bin (OutOfRangeMode::Clamp), and is counted in getDroppedPoints() or
+// getClampedPoints(). The check is folded into the scatter loop without branches, so it costs about the same
+// as the unchecked scatter it replaces. A NaN or infinite value is binned to the underflow guard bin and its point
+// is counted as dropped in either mode, without being sketched.
+
+template <typename T, typename CountT = T,
+  typename = typename std::enable_if<std::is_arithmetic<T>::value && std::is_arithmetic<CountT>::value, T>::type>
+  class Hist2D : public Hist2DAlignment
+  {
+  public:
+  typedef CountT count_type;
+  // Type wide enough to report any bin's full count, including counts spilled on overflow
+  typedef typename std::conditional<std::is_integral<CountT>::value, unsigned long long, double>::type total_type;
+
+  Hist2D(int xBins=26, int yBins=28, double xMin = -.1, double xMax = 24, double yMin = -.1, double yMax = 25.1) :
+  m_xBins(xBins), m_yBins(yBins),  m_xMin(xMin), m_xMax(xMax), m_yMin(yMin), m_yMax(yMax), m_xVals(xBins+1), m_yVals(yBins+1),
+  m_sparse(useSparse(xBins, yBins)), m_matrixCount(boost::extents[denseShape(yBins, m_sparse)][denseShape(xBins, m_sparse)]), m_tiles(sparseShape(yBins, m_sparse), sparseShape(xBins, m_sparse))
+  {
+    // Initializes all bins to 0
+    std::fill(m_matrixCount.origin(), m_matrixCount.origin() + m_matrixCount.num_elements(), 0);
+
+    // Calculates binning increments for x and y
+    double xInc = (xMax - xMin)/xBins;
+    double yInc = (yMax - yMin)/yBins;
+    for ( int i = 0; i<(xBins+1); i++ ) { m_xVals[i] = xMin + i*xInc; }
+    for ( int i = 0; i<(yBins+1); i++ ) { m_yVals[i] = yMin + i*yInc; }
+    setupLookup();
+  }
+    
+  // Builds a histogram over arbitrary, strictly increasing bin edges
+  // (xEdges.size() - 1 x bins and yEdges.size() - 1 y bins).
+  // Evenly spaced edges still get the arithmetic bin lookup, anything else falls back to a binary search.
+  Hist2D(const std::vector<double>& xEdges, const std::vector<double>& yEdges) :
+  m_xBins(xEdges.size() - 1), m_yBins(yEdges.size() - 1), m_xMin(xEdges.front()), m_xMax(xEdges.back()), m_yMin(yEdges.front()), m_yMax(yEdges.back()),
+  m_xVals(xEdges), m_yVals(yEdges),
+  m_sparse(useSparse(m_xBins, m_yBins)), m_matrixCount(boost::extents[denseShape(m_yBins, m_sparse)][denseShape(m_xBins, m_sparse)]), m_tiles(sparseShape(m_yBins, m_sparse), sparseShape(m_xBins, m_sparse))
+  {
+    std::fill(m_matrixCount.origin(), m_matrixCount.origin() + m_matrixCount.num_elements(), 0);
+    setupLookup();
+  }
+
+  // Adds all series to histogram as passed in through container VectorOfNumericVectors
+  void addToHist(const VectorOfNumericVectors<T>& listOfVectors, Alignment alignment ){
+    const auto& list = listOfVectors.getVector();
+    for ( auto it = list.begin(); it!=list.end(); ++it ) {
+      addToHist(*it, alignment);
+    }
+  }
+
+  // Adds every series of a FlatVectorOfNumericVectors, straight from its contiguous storage
+  void addToHist(const FlatVectorOfNumericVectors<T>& listOfVectors, Alignment alignment ){
+    for ( std::size_t i = 0; i < listOfVectors.size(); i++ ) {
+      addToHist(listOfVectors[i], alignment);
+    }
+  }
+
+  // Adds single series to histogram
+  // See enum definition above for description of Alignment types
+  // Each point adds weight to its bin; weights other than 1 are meant for floating point CountT
+  void addToHist(const NumericVector<T>& numVector, Alignment alignment, CountT weight = 1) {
+    addSeries(numVector.getYConst().data(), numVector.getXConst().data(), numVector.getYConst().size(),
+	      numVector.m_maxY, numVector.m_minY, alignment, weight);
+  }
+
+  void addToHist(const NumericSeriesView<T>& view, Alignment alignment, CountT weight = 1) {
+    addSeries(view.getYData(), view.getXData(), view.length, view.m_maxY, view.m_minY, alignment, weight);
+  }
+
+  const std::vector<double>& getXEdges() const { return m_xVals; }
+  const std::vector<double>& getYEdges() const { return m_yVals; }
+  int getXBins() const { return m_xBins; }
+  int getYBins() const { return m_yBins; }
+
+  // Grids of more than SPARSE_CELL_THRESHOLD bins keep their counts in tiles allocated on first touch
+  bool isSparse() const { return m_sparse; }
+  // Bytes currently used by the bin counters
+  std::size_t countBytes() const {
+    return m_sparse ? m_tiles.memoryBytes() : m_matrixCount.num_elements() * sizeof(CountT);
+  }
+
+  // Full count of the bin at row yBin and column xBin, including anything spilled on overflow.
+  // Rows -1 and getYBins() and columns -1 and getXBins() are the guard bins holding dropped points.
+  total_type getCount(int yBin, int xBin) const { return storedCount(yBin + 1, xBin + 1); }
+
+  // Sets the full count of one bin (guard bins included), e.g. when restoring a saved histogram.
+  // A count too large for CountT is kept in the 64-bit side table, as with widening.
+  void setCount(int yBin, int xBin, total_type count) {
+    std::size_t key = spillKey(yBin + 1, xBin + 1);
+    m_spill.erase(key);
+    if ( count <= (total_type) std::numeric_limits<CountT>::max() ) {
+      cell(yBin + 1, xBin + 1) = (CountT) count;
+    } else {
+      cell(yBin + 1, xBin + 1) = 0;
+      m_spill[key] = count;
+    }
+  }
+
+  // Chooses what happens to points outside the bins from now on; see OutOfRangeMode
+  void setOutOfRangeMode(OutOfRangeMode mode) { m_outOfRange = mode; }
+  OutOfRangeMode getOutOfRangeMode() const { return m_outOfRange; }
+
+  // Number of points left in the guard bins, and number moved onto an edge bin, whatever their weights
+  std::uint64_t getDroppedPoints() const { return m_dropped; }
+  std::uint64_t getClampedPoints() const { return m_clamped; }
+  // Sets both counters, e.g. when restoring a saved histogram
+  void setOutOfRangePoints(std::uint64_t dropped, std::uint64_t clamped) {
+    m_dropped = dropped;
+    m_clamped = clamped;
+  }
+
+  // When on, a counter about to overflow CountT moves its count into a 64-bit side table and restarts from 0.
+  // Off by default, in which case counters behave like plain CountT arithmetic.
+  void setWidenOnOverflow(bool widen) { m_widenOnOverflow = widen; }
+  bool getWidenOnOverflow() const { return m_widenOnOverflow; }
+
+  // Starts keeping a quantile sketch of the y values in each x bin, for every alignment (see QuantileSketch.h).
+  // k sets the accuracy, roughly 1.7 / k rank error for about 24k bytes per x bin at most.
+  // Only points added from now on are sketched. Weights are rounded to whole numbers of points.
+  void trackQuantiles(int k = 200) {
+    m_quantiles.assign(m_xBins, QuantileSketch<double>(k));
+  }
+  bool hasQuantiles() const { return !m_quantiles.empty(); }
+  const QuantileSketch<double>& getQuantileSketch(int xBin) const { return m_quantiles[xBin]; }
+
+  // Approximate q quantile of the y values in one x bin, NaN if the bin is empty
+  double getQuantile(int xBin, double q) const { return m_quantiles[xBin].quantile(q); }
+
+  // The q quantile of every x bin in turn, e.g. getQuantileCurve(.5) for the median trajectory
+  std::vector<double> getQuantileCurve(double q) const {
+    std::vector<double> curve(m_quantiles.size());
+    for ( std::size_t x = 0; x < m_quantiles.size(); x++ ) curve[x] = m_quantiles[x].quantile(q);
+    return curve;
+  }
+
+  // Returns true if other has exactly the same bin edges as this histogram, so the two can be merged
+  bool sameLayout(const Hist2D& other) const {
+    return m_xBins == other.m_xBins && m_yBins == other.m_yBins &&
+      m_xVals == other.m_xVals && m_yVals == other.m_yVals;
+  }
+
+  // Adds the counts of other into this histogram bin by bin
+  // Both histograms must have been built with identical bins, otherwise std::invalid_argument is thrown
+  // Quantile sketches are merged too. Either both histograms track quantiles or neither does, otherwise
+  // std::invalid_argument is thrown: the sketches on one side would miss the points counted on the other.
+  void merge(const Hist2D& other) {
+    if ( !sameLayout(other) ) {
+      throw std::invalid_argument("Hist2D merge requires histograms with identical bin layouts");
+    }
+    if ( hasQuantiles() != other.hasQuantiles() ) {
+      throw std::invalid_argument("Hist2D merge requires both histograms or neither to track quantiles");
+    }
+    if ( hasQuantiles() ) {
+      for ( int x = 0; x < m_xBins; x++ ) m_quantiles[x].merge(other.m_quantiles[x]);
+    }
+    if ( m_widenOnOverflow ) {
+      for ( int i = 0; i < m_yBins + 2; i++ ) {
+	for ( int j = 0; j < m_xBins + 2; j++ ) {
+	  CountT count = other.cellValue(i, j);
+	  if ( count != 0 ) addChecked(i, j, count);
+	}
+      }
+    } else if ( m_sparse ) {
+      m_tiles.add(other.m_tiles);
+    } else {
+      const CountT* from = other.m_matrixCount.origin();
+      CountT* to = m_matrixCount.origin();
+      for ( std::size_t i = 0; i < m_matrixCount.num_elements(); i++ ) {
+	to[i] += from[i];
+      }
+    }
+    for ( auto& spilled: other.m_spill ) {
+      m_spill[spilled.first] += spilled.second;
+    }
+    m_dropped += other.m_dropped;
+    m_clamped += other.m_clamped;
+  }
+
+  Hist2D& operator+=(const Hist2D& other) {
+    merge(other);
+    return *this;
+  }
+
+  // Removes the counts of other from this histogram bin by bin, undoing an earlier merge of other
+  // (as RollingHist2D does when a time slice leaves its window). Same layout requirement as merge.
+  // With widening on, a counter smaller than the amount removed borrows the rest from its spilled count.
+  // Quantile sketches cannot forget values, so a histogram tracking quantiles cannot be subtracted from.
+  void subtract(const Hist2D& other) {
+    if ( !sameLayout(other) ) {
+      throw std::invalid_argument("Hist2D subtract requires histograms with identical bin layouts");
+    }
+    if ( hasQuantiles() ) {
+      throw std::invalid_argument("Hist2D subtract is not supported while tracking quantiles");
+    }
+    m_dropped -= other.m_dropped;
+    m_clamped -= other.m_clamped;
+    if ( m_widenOnOverflow ) {
+      for ( int i = 0; i < m_yBins + 2; i++ ) {
+	for ( int j = 0; j < m_xBins + 2; j++ ) {
+	  total_type amount = other.storedCount(i, j);
+	  if ( amount != 0 ) subtractChecked(i, j, amount);
+	}
+      }
+      return;
+    }
+    if ( m_sparse ) {
+      m_tiles.subtract(other.m_tiles);
+    } else {
+      const CountT* from = other.m_matrixCount.origin();
+      CountT* to = m_matrixCount.origin();
+      for ( std::size_t i = 0; i < m_matrixCount.num_elements(); i++ ) {
+	to[i] -= from[i];
+      }
+    }
+    for ( auto& spilled: other.m_spill ) {
+      m_spill[spilled.first] -= spilled.second;
+    }
+  }
+
+  Hist2D& operator-=(const Hist2D& other) {
+    subtract(other);
+    return *this;
+  }
+
+  // Sets every bin back to 0, keeping the layout and settings
+  void clear() {
+    std::fill(m_matrixCount.origin(), m_matrixCount.origin() + m_matrixCount.num_elements(), 0);
+    m_tiles.clear();
+    m_spill.clear();
+    m_dropped = 0;
+    m_clamped = 0;
+    for ( auto& sketch: m_quantiles ) sketch.clear();
+  }
+
+  void print(std::ostream& os) const {
+    int width = m_yBins;
+    int height = m_xBins;
+    os << "xbins, ybins, xmin, xmax, ymin, ymax" << std::endl;
+    os << m_xBins << ", " << m_yBins << ", " << m_xMin << ", " << m_xMax  << ", " << m_yMin << ", " << m_yMax << std::endl;
+    for ( int i = 0; i < width; i++ ) {
+      for ( int j = 0; j < (height -1); j++ ) {
+	os << " " << getCount(i, j) << ",  ";
+      }
+      // Separates out last column of each line to avoid stray ',' at end of each row
+      os << " " << getCount(i, height-1);
+      os << std::endl;
+    }
+  }
+
+  private:
+  template <typename, typename, Hist2DAlignment::Alignment...> friend class Hist2DBank;
+
+  int m_xBins;
+  int m_yBins;
+  T m_xMin;
+  T m_xMax;
+  T m_yMin;
+  T m_yMax;
+  std::vector<double> m_xVals;
+  std::vector<double> m_yVals;
+  typedef boost::multi_array<CountT, 2> array_type;
+  bool m_sparse;                  // counts live in m_tiles rather than m_matrixCount
+  array_type m_matrixCount;
+  TiledCounts<CountT> m_tiles;
+  bool m_widenOnOverflow = false;
+  std::unordered_map<std::size_t, total_type> m_spill;   // overflowed counts by flat bin index
+  std::vector<QuantileSketch<double>> m_quantiles;        // one per x bin when tracking quantiles, else empty
+  OutOfRangeMode m_outOfRange = OutOfRangeMode::Drop;
+  std::uint64_t m_dropped = 0;
+  std::uint64_t m_clamped = 0;
+  bool m_xUniform;
+  bool m_yUniform;
+  double m_xInvInc;
+  double m_yInvInc;
+  std::vector<int> m_xScratch;
+  std::vector<int> m_yScratch;
+
+  // Bins are stored shifted by one to make room for the guard bins: bin k of the histogram is
+  // row or column k + 1 of the storage, and -1 and bins are rows or columns 0 and bins + 1.
+  // cell(), cellValue(), storedCount() and the m_spill keys all take storage coordinates.
+
+  // The y bin of every point is computed in one pass over the series, then the x bins in a second pass,
+  // and only then are the counts scattered into the matrix. For evenly spaced bins both passes are plain
+  // arithmetic (see binValues) rather than a binary search per point.
+  void addSeries(const T* toAddY, const T* toAddX, int n, T maxY, T minY, Alignment alignment, CountT weight) {
+    INSTRUMENT_SCOPE(Bin);
+    m_yScratch.resize(n);
+    m_xScratch.resize(n);
+    int nonFinite = binValues(toAddY, n, m_yVals, m_yUniform, m_yInvInc, m_yScratch.data());
+
+    // The first four alignments place point j of the series at x position start + j
+    int start;
+    switch(alignment){
+    case Alignment::Front :
+      INSTRUMENT_COUNT(BinFront, 1);
+      start = 0;
+      break;
+    case Alignment::Back :
+      INSTRUMENT_COUNT(BinBack, 1);
+      // last point goes to x position shape()[0] - 1
+      start = m_yBins - n;
+      break;
+    case Alignment::AtMax :
+      INSTRUMENT_COUNT(BinAtMax, 1);
+      start = m_yBins/2 - (std::find(toAddY, toAddY + n, maxY) - toAddY);
+      break;
+    case Alignment::AtMin :
+      INSTRUMENT_COUNT(BinAtMin, 1);
+      start = m_yBins/2 - (std::find(toAddY, toAddY + n, minY) - toAddY);
+      break;
+    case Alignment::ByX :
+      INSTRUMENT_COUNT(BinByX, 1);
+      nonFinite += binValues(toAddX, n, m_xVals, m_xUniform, m_xInvInc, m_xScratch.data());
+      place(toAddY, toAddX, m_yScratch.data(), m_xScratch.data(), n, nonFinite, weight);
+      return;
+    default:
+      std::cout << "Improper alignment parameter in Hist2D addToHist method" << std::endl;
+      return;
+    }
+    binPositions(start, n, m_xVals, m_xUniform, m_xInvInc, m_xScratch.data());
+    place(toAddY, nullptr, m_yScratch.data(), m_xScratch.data(), n, nonFinite, weight);
+  }
+
+  // Grids with more cells than this are stored sparsely in tiles allocated on first touch
+  static const long long SPARSE_CELL_THRESHOLD = 1 << 20;
+
+  static bool useSparse(int xBins, int yBins) {
+    return (long long) xBins * yBins > SPARSE_CELL_THRESHOLD;
+  }
+  // Only the storage in use is given a shape, the other one stays empty. Both include the guard bins.
+  static int denseShape(int bins, bool sparse) { return sparse ? 0 : bins + 2; }
+  static int sparseShape(int bins, bool sparse) { return sparse ? bins + 2 : 0; }
+
+  CountT& cell(int yBin, int xBin) {
+    return m_sparse ? m_tiles.at(yBin, xBin) : m_matrixCount[yBin][xBin];
+  }
+  CountT cellValue(int yBin, int xBin) const {
+    return m_sparse ? m_tiles.get(yBin, xBin) : m_matrixCount[yBin][xBin];
+  }
+  total_type storedCount(int yBin, int xBin) const {
+    total_type count = cellValue(yBin, xBin);
+    if ( !m_spill.empty() ) {
+      auto it = m_spill.find(spillKey(yBin, xBin));
+      if ( it != m_spill.end() ) count += it->second;
+    }
+    return count;
+  }
+  std::size_t spillKey(int yBin, int xBin) const { return (std::size_t) yBin * (m_xBins + 2) + xBin; }
+
+  // Edges are treated as uniform when every edge is within a tiny tolerance of its evenly spaced position.
+  // The tolerance only affects speed, never results, since binValues corrects the arithmetic guess against the real edges.
+  static bool isUniform(const std::vector<double>& edges) {
+    int bins = edges.size() - 1;
+    double inc = (edges.back() - edges.front())/bins;
+    if ( !(inc > 0) ) return false;
+    for ( int i = 1; i < bins; i++ ) {
+      if ( std::fabs(edges[i] - (edges.front() + i*inc)) > 1e-6*inc ) return false;
+    }
+    return true;
+  }
+
+  void setupLookup() {
+    m_xUniform = isUniform(m_xVals);
+    m_yUniform = isUniform(m_yVals);
+    m_xInvInc = m_xBins/(m_xVals.back() - m_xVals.front());
+    m_yInvInc = m_yBins/(m_yVals.back() - m_yVals.front());
+  }
+
+  static int clampBin(int k, int bins) { return std::min(std::max(k, 0), bins - 1); }
+
+  // Counts and sketches n points given their y values and bins. toAddX holds the x values when the x bins were
+  // computed from them (ByX), and nonFinite is the number of NaN or infinite values binValues found.
+  void place(const T* toAddY, const T* toAddX, const int* ys, const int* xs, int n, int nonFinite, CountT weight) {
+    if ( nonFinite > 0 ) {
+      placeNonFinite(toAddY, toAddX, ys, xs, n, weight);
+      return;
+    }
+    scatter(ys, xs, n, weight);
+    if ( hasQuantiles() ) sketch(toAddY, xs, n, weight);
+  }
+
+  // Slow path for a series holding NaN or infinite values, point by point: binValues has already put them in
+  // the underflow guard bin, and they are counted as dropped even in Clamp mode and are not sketched
+  void placeNonFinite(const T* toAddY, const T* toAddX, const int* ys, const int* xs, int n, CountT weight) {
+    for ( int j = 0; j < n; j++ ) {
+      if ( isFinite(toAddY[j]) && (toAddX == nullptr || isFinite(toAddX[j])) ) {
+	place(toAddY + j, nullptr, ys + j, xs + j, 1, 0, weight);
+      } else {
+	m_dropped += scatterPlaced<false>(ys + j, xs + j, 1, weight);
+      }
+    }
+  }
+
+  template <typename V>
+  static bool isFinite(V v) { return !std::is_floating_point<V>::value || std::isfinite((double) v); }
+
+  // Adds weight to the bin of each of n points, with y bins ys[j] and x bins xs[j] in [-1, bins].
+  // Points outside the grid are counted as dropped or clamped, and the mode, widening and storage are
+  // checked once per call, so the loop that runs per point has no branches (see scatterWith).
+  void scatter(const int* ys, const int* xs, int n, CountT weight) {
+    if ( m_outOfRange == OutOfRangeMode::Clamp ) {
+      m_clamped += scatterPlaced<true>(ys, xs, n, weight);
+    } else {
+      m_dropped += scatterPlaced<false>(ys, xs, n, weight);
+    }
+  }
+
+  template <bool Clamp>
+  std::uint64_t scatterPlaced(const int* ys, const int* xs, int n, CountT weight) {
+    if ( m_widenOnOverflow ) {
+      return scatterWith<Clamp>(ys, xs, n, m_yBins, m_xBins, [&](int y, int x) { addChecked(y, x, weight); });
+    }
+    if ( m_sparse ) {
+      TiledCounts<CountT>& tiles = m_tiles;
+      return scatterWith<Clamp>(ys, xs, n, m_yBins, m_xBins, [&](int y, int x) { tiles.at(y, x) += weight; });
+    }
+    CountT* counts = m_matrixCount.origin();
+    std::size_t row = m_xBins + 2;
+    return scatterWith<Clamp>(ys, xs, n, m_yBins, m_xBins, [=](int y, int x) { counts[y * row + x] += weight; });
+  }
+
+  // Calls add(row, column) with the storage coordinates of each point and returns the number of points outside
+  // the grid. Indices are compared as unsigned, so -1 and bins both test out of range in one comparison.
+  template <bool Clamp, typename Add>
+  static std::uint64_t scatterWith(const int* ys, const int* xs, int n, int yBins, int xBins, Add add) {
+    std::uint64_t outside = 0;
+    for ( int j = 0; j < n; j++ ) {
+      int y = ys[j], x = xs[j];
+      outside += ((unsigned) y >= (unsigned) yBins) | ((unsigned) x >= (unsigned) xBins);
+      if ( Clamp ) {
+	y = clampBin(y, yBins);
+	x = clampBin(x, xBins);
+      }
+      add(y + 1, x + 1);
+    }
+    return outside;
+  }
+
+  // Adds each y value to the sketch of the x bin it was counted in, given the x bins passed to scatter
+  void sketch(const T* toAddY, const int* xs, int n, CountT weight) {
+    std::uint64_t points = sketchWeight(weight);
+    if ( m_outOfRange == OutOfRangeMode::Clamp ) {
+      for ( int j = 0; j < n; j++ ) sketchPoint(clampBin(xs[j], m_xBins), toAddY[j], points);
+    } else {
+      for ( int j = 0; j < n; j++ ) sketchPoint(xs[j], toAddY[j], points);
+    }
+  }
+
+  // Points outside the x range are not sketched
+  void sketchPoint(int xBin, double y, std::uint64_t points) {
+    if ( xBin >= 0 && xBin < m_xBins ) m_quantiles[xBin].add(y, points);
+  }
+
+  // Number of points a weight counts for in the sketches: the weight rounded, and nothing for weights <= 0
+  static std::uint64_t sketchWeight(CountT weight) {
+    return (double) weight > 0 ? (std::uint64_t) std::llround((double) weight) : 0;
+  }
+
+  // Adds amount to the counter of a bin, spilling the counter into m_spill if CountT would overflow
+  void addChecked(int yBin, int xBin, CountT amount) {
+    CountT& counter = cell(yBin, xBin);
+    if ( counter > std::numeric_limits<CountT>::max() - amount ) {
+      m_spill[spillKey(yBin, xBin)] += (total_type) counter + amount;
+      counter = 0;
+    } else {
+      counter += amount;
+    }
+  }
+
+  // Removes amount from a bin whose full count (counter plus spill) is at least amount
+  void subtractChecked(int yBin, int xBin, total_type amount) {
+    CountT& counter = cell(yBin, xBin);
+    if ( (total_type) counter >= amount ) {
+      counter -= (CountT) amount;
+      return;
+    }
+    std::size_t key = spillKey(yBin, xBin);
+    m_spill[key] -= amount - counter;
+    counter = 0;
+    if ( m_spill[key] == 0 ) m_spill.erase(key);
+  }
+
+  // Bin index of a single value, with the same result as binValues
+  static int binOne(const std::vector<double>& edges, bool uniform, double invInc, double v) {
+    if ( !uniform ) return searchBin(edges, v);
+    if ( !isFinite(v) ) return -1;
+    double guess = std::ceil((v - edges.front())*invInc);
+    return correctBin(edges, v, (int) std::min(std::max(guess, 0.0), (double) edges.size()) - 1);
+  }
+
+  // Bin index of v as defined by the original binary search:
+  // the bin k with edges[k] < v <= edges[k+1], -1 below the first edge and edges.size() - 1 past the last one
+  static int searchBin(const std::vector<double>& edges, double v) {
+    return std::lower_bound(edges.begin(), edges.end(), v) - edges.begin() - 1;
+  }
+
+  // Moves an arithmetic guess k onto the exact searchBin() answer. With uniform edges
+  // the guess is off by at most one step from rounding, so each loop runs at most once.
+  static int correctBin(const std::vector<double>& edges, double v, int k) {
+    int last = edges.size() - 1;
+    while ( k >= 0 && edges[k] >= v ) --k;
+    while ( k < last && edges[k + 1] < v ) ++k;
+    return k;
+  }
+
+  // Computes the bin index of values[0..n) into out
+  // Uniform edges use ceil((v - min) * invInc) - 1, vectorized with AVX2 where available, followed by a
+  // scalar correction against the actual edges. Non-uniform edges use a binary search per value.
+  // NaN and infinite values are given the underflow bin -1; returns how many there were.
+  template <typename V>
+  static int binValues(const V* values, int n, const std::vector<double>& edges, bool uniform, double invInc, int* out) {
+    if ( !uniform ) {
+      for ( int j = 0; j < n; j++ ) out[j] = searchBin(edges, values[j]);
+      return markNonFinite(values, n, out);
+    }
+    double low  = edges.front();
+    double high = edges.size();   // guesses are clamped to [0, edges.size()] before the -1
+    int j = guessBins(values, n, low, invInc, high, out);
+    for ( ; j < n; j++ ) {
+      // NaN fails the comparison, so no non-finite guess reaches the cast
+      double guess = std::ceil((values[j] - low)*invInc);
+      out[j] = guess >= 0.0 ? (int) std::min(guess, high) - 1 : -1;
+    }
+    for ( j = 0; j < n; j++ ) out[j] = correctBin(edges, values[j], out[j]);
+    return markNonFinite(values, n, out);
+  }
+
+  // Moves the bins of NaN and infinite values to -1 and returns their number; integer values need no pass
+  template <typename V>
+  static int markNonFinite(const V* values, int n, int* out) {
+    if ( !std::is_floating_point<V>::value ) return 0;
+    int nonFinite = 0;
+    for ( int j = 0; j < n; j++ ) {
+      if ( !std::isfinite((double) values[j]) ) {
+	out[j] = -1;
+	nonFinite++;
+      }
+    }
+    return nonFinite;
+  }
+
+  // Same as binValues for the consecutive integer positions start, start + 1, ..., start + n - 1
+  static void binPositions(int start, int n, const std::vector<double>& edges, bool uniform, double invInc, int* out) {
+    if ( !uniform ) {
+      for ( int j = 0; j < n; j++ ) out[j] = searchBin(edges, start + j);
+      return;
+    }
+    double low  = edges.front();
+    double high = edges.size();
+    for ( int j = 0; j < n; j++ ) {
+      double guess = std::ceil((start + j - low)*invInc);
+      out[j] = (int) std::min(std::max(guess, 0.0), high) - 1;
+    }
+    for ( int j = 0; j < n; j++ ) out[j] = correctBin(edges, start + j, out[j]);
+  }
+
+  // Vectorized arithmetic guess for as many leading values as the instruction set allows.
+  // Returns the number of values handled; the caller finishes the remainder.
+  template <typename V>
+  static int guessBins(const V*, int, double, double, double, int*) { return 0; }
+
+#if defined(__AVX2__)
+  static int guessBins4(__m256d v, double low, double invInc, double high, int* out) {
+    __m256d guess = _mm256_ceil_pd(_mm256_mul_pd(_mm256_sub_pd(v, _mm256_set1_pd(low)), _mm256_set1_pd(invInc)));
+    // maxpd returns its second operand when either is NaN, so NaN guesses become 0 before the conversion
+    guess = _mm256_min_pd(_mm256_max_pd(guess, _mm256_setzero_pd()), _mm256_set1_pd(high));
+    __m128i k = _mm_sub_epi32(_mm256_cvttpd_epi32(guess), _mm_set1_epi32(1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), k);
+    return 4;
+  }
+  static int guessBins(const int* values, int n, double low, double invInc, double high, int* out) {
+    int j = 0;
+    for ( ; j + 4 <= n; j += 4 ) {
+      __m256d v = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + j)));
+      guessBins4(v, low, invInc, high, out + j);
+    }
+    return j;
+  }
+  static int guessBins(const double* values, int n, double low, double invInc, double high, int* out) {
+    int j = 0;
+    for ( ; j + 4 <= n; j += 4 ) {
+      guessBins4(_mm256_loadu_pd(values + j), low, invInc, high, out + j);
+    }
+    return j;
+  }
+#endif
+
+
+  };
+
+#endif // HIST_2D
@@ -0,0 +1,237 @@
+#ifndef INSTRUMENTATION
+#define INSTRUMENTATION
+
+// Per-stage timers and counters for the processing hot paths.
+// Everything here is compiled in only when HIST_INSTRUMENT is defined (make demo_instrumented);
+// otherwise the INSTRUMENT_ macros expand to nothing and cost nothing.
+//
+//   INSTRUMENT_SCOPE(Parse)          times the enclosing scope as one call of a stage, in CPU cycles.
+//                                    Stages nest, so the time of an outer stage includes its inner stages.
+//   INSTRUMENT_COUNT(Points, n)      adds n to a counter
+//   INSTRUMENT_MAX(LongestSeries, n) raises a counter to at least n
+//   INSTRUMENT_SETUP()               dumps a JSON summary at exit, and whenever SIGUSR1 is received
+//                                    and a thread next reaches INSTRUMENT_POLL()
+//   INSTRUMENT_GROUP(name, s, p)     records the series and point count of one group for the summary
+//
+// Each thread accumulates into its own block of counters, written only by that thread, so the hot
+// paths use no locks or atomic read-modify-writes. The blocks outlive their threads and are summed
+// when the summary is written. The summary goes to the file named by HIST_INSTRUMENT_FILE, or to stderr.
+
+#ifdef HIST_INSTRUMENT
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace instrument {
+
+enum Stage { Read, Parse, TimeBucket, Construct, Traits, Bin, Merge, Write, STAGE_COUNT };
+enum Counter { Rows, Points, Series, LongestSeries, BytesRead, BytesWritten,
+	       BinFront, BinBack, BinAtMax, BinAtMin, BinByX, COUNTER_COUNT };
+
+const char* const STAGE_NAMES[STAGE_COUNT] = {"read", "parse", "time_bucket", "construct", "traits", "bin", "merge", "write"};
+const char* const COUNTER_NAMES[COUNTER_COUNT] = {"rows", "points", "series", "longest_series", "bytes_read", "bytes_written",
+						   "bin_front", "bin_back", "bin_atmax", "bin_atmin", "bin_byx"};
+
+inline std::uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Counters of one thread. Only the owning thread writes them, with relaxed loads and stores,
+// so a summary written from another thread reads consistent (if slightly stale) values.
+struct ThreadStats {
+  std::atomic<std::uint64_t> stageCycles[STAGE_COUNT];
+  std::atomic<std::uint64_t> stageCalls[STAGE_COUNT];
+  std::atomic<std::uint64_t> counters[COUNTER_COUNT];
+
+  ThreadStats() {
+    for ( int i = 0; i < STAGE_COUNT; i++ ) { stageCycles[i] = 0; stageCalls[i] = 0; }
+    for ( int i = 0; i < COUNTER_COUNT; i++ ) counters[i] = 0;
+  }
+
+  static void add(std::atomic<std::uint64_t>& value, std::uint64_t amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+  static void raise(std::atomic<std::uint64_t>& value, std::uint64_t amount) {
+    if ( amount > value.load(std::memory_order_relaxed) ) value.store(amount, std::memory_order_relaxed);
+  }
+};
+
+class Registry
+{
+ public:
+  static Registry& get() {
+    static Registry registry;
+    return registry;
+  }
+
+  ThreadStats& local() {
+    static thread_local ThreadStats* stats = nullptr;
+    if ( stats == nullptr ) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_threads.push_back(std::unique_ptr<ThreadStats>(new ThreadStats()));
+      stats = m_threads.back().get();
+    }
+    return *stats;
+  }
+
+  void recordGroup(const std::string& name, std::uint64_t series, std::uint64_t points) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_groups.push_back(Group{name, series, points});
+  }
+
+  // Set from the signal handler, checked by poll()
+  static volatile std::sig_atomic_t& dumpRequested() {
+    static volatile std::sig_atomic_t requested = 0;
+    return requested;
+  }
+
+  void poll() {
+    if ( dumpRequested() ) {
+      dumpRequested() = 0;
+      dump();
+    }
+  }
+
+  // Writes the summed counters of all threads as one JSON object
+  void dump() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::uint64_t stageCycles[STAGE_COUNT] = {}, stageCalls[STAGE_COUNT] = {}, counters[COUNTER_COUNT] = {};
+    for ( auto& thread: m_threads ) {
+      for ( int i = 0; i < STAGE_COUNT; i++ ) {
+	stageCycles[i] += thread->stageCycles[i].load(std::memory_order_relaxed);
+	stageCalls[i]  += thread->stageCalls[i].load(std::memory_order_relaxed);
+      }
+      for ( int i = 0; i < COUNTER_COUNT; i++ ) {
+	std::uint64_t value = thread->counters[i].load(std::memory_order_relaxed);
+	counters[i] = i == LongestSeries ? std::max(counters[i], value) : counters[i] + value;
+      }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+    double cyclesPerSecond = seconds > 0 ? (cycles() - m_startCycles) / seconds : 0;
+
+    const char* filename = std::getenv("HIST_INSTRUMENT_FILE");
+    std::FILE* out = filename != nullptr ? std::fopen(filename, "w") : nullptr;
+    if ( out == nullptr ) out = stderr;
+    std::fprintf(out, "{\"elapsed_seconds\":%.6f,\"threads\":%zu,\"stages\":{", seconds, m_threads.size());
+    for ( int i = 0; i < STAGE_COUNT; i++ ) {
+      std::fprintf(out, "%s\"%s\":{\"calls\":%llu,\"cycles\":%llu,\"seconds\":%.6f}", i ? "," : "", STAGE_NAMES[i],
+		   (unsigned long long) stageCalls[i], (unsigned long long) stageCycles[i],
+		   cyclesPerSecond > 0 ? stageCycles[i] / cyclesPerSecond : 0.0);
+    }
+    std::fprintf(out, "},\"counters\":{");
+    for ( int i = 0; i < COUNTER_COUNT; i++ ) {
+      std::fprintf(out, "%s\"%s\":%llu", i ? "," : "", COUNTER_NAMES[i], (unsigned long long) counters[i]);
+    }
+    std::fprintf(out, "},\"groups\":{");
+    for ( std::size_t i = 0; i < m_groups.size(); i++ ) {
+      if ( i ) std::fputc(',', out);
+      writeJsonString(out, m_groups[i].name);
+      std::fprintf(out, ":{\"series\":%llu,\"points\":%llu}",
+		   (unsigned long long) m_groups[i].series, (unsigned long long) m_groups[i].points);
+    }
+    std::fprintf(out, "}}\n");
+    if ( out != stderr ) std::fclose(out);
+    else std::fflush(out);
+  }
+
+  // Dumps at exit and on SIGUSR1 (at the next poll)
+  void setup() {
+    std::atexit([] { Registry::get().dump(); });
+    std::signal(SIGUSR1, [](int) { Registry::dumpRequested() = 1; });
+  }
+
+ private:
+  struct Group {
+    std::string name;
+    std::uint64_t series;
+    std::uint64_t points;
+  };
+
+  std::mutex m_mutex;
+  std::vector<std::unique_ptr<ThreadStats>> m_threads;
+  std::vector<Group> m_groups;
+  std::chrono::steady_clock::time_point m_startTime;
+  std::uint64_t m_startCycles;
+
+  // Writes s as a quoted JSON string. Group names come from the input data, so quotes, backslashes
+  // and control characters are escaped; other bytes, including UTF-8 sequences, are written as they are.
+  static void writeJsonString(std::FILE* out, const std::string& s) {
+    std::fputc('"', out);
+    for ( unsigned char c: s ) {
+      switch ( c ) {
+      case '"':  std::fputs("\\\"", out); break;
+      case '\\': std::fputs("\\\\", out); break;
+      case '\n': std::fputs("\\n", out); break;
+      case '\r': std::fputs("\\r", out); break;
+      case '\t': std::fputs("\\t", out); break;
+      default:
+	if ( c < 0x20 ) std::fprintf(out, "\\u%04x", c);
+	else std::fputc(c, out);
+      }
+    }
+    std::fputc('"', out);
+  }
+
+  Registry() : m_startTime(std::chrono::steady_clock::now()), m_startCycles(cycles()) {}
+};
+
+// Adds the cycles between construction and destruction to one stage of the calling thread
+class ScopedTimer
+{
+ public:
+  explicit ScopedTimer(Stage stage) : m_stats(Registry::get().local()), m_stage(stage), m_start(cycles()) {}
+  ~ScopedTimer() {
+    ThreadStats::add(m_stats.stageCycles[m_stage], cycles() - m_start);
+    ThreadStats::add(m_stats.stageCalls[m_stage], 1);
+  }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+ private:
+  ThreadStats& m_stats;
+  Stage m_stage;
+  std::uint64_t m_start;
+};
+
+} // namespace instrument
+
+#define INSTRUMENT_JOIN2(a, b) a##b
+#define INSTRUMENT_JOIN(a, b) INSTRUMENT_JOIN2(a, b)
+#define INSTRUMENT_SCOPE(stage) instrument::ScopedTimer INSTRUMENT_JOIN(instrumentTimer, __LINE__)(instrument::stage)
+#define INSTRUMENT_COUNT(counter, n) \
+  instrument::ThreadStats::add(instrument::Registry::get().local().counters[instrument::counter], (n))
+#define INSTRUMENT_MAX(counter, n) \
+  instrument::ThreadStats::raise(instrument::Registry::get().local().counters[instrument::counter], (n))
+#define INSTRUMENT_GROUP(name, series, points) instrument::Registry::get().recordGroup((name), (series), (points))
+#define INSTRUMENT_SETUP() instrument::Registry::get().setup()
+#define INSTRUMENT_POLL() instrument::Registry::get().poll()
+
+#else
+
+#define INSTRUMENT_SCOPE(stage)
+#define INSTRUMENT_COUNT(counter, n)
+#define INSTRUMENT_MAX(counter, n)
+#define INSTRUMENT_GROUP(name, series, points)
+#define INSTRUMENT_SETUP()
+#define INSTRUMENT_POLL()
+
+#endif // HIST_INSTRUMENT
+
+#endif // INSTRUMENTATION
@@ -0,0 +1,189 @@
+#ifndef QUANTILE_SKETCH
+#define QUANTILE_SKETCH
+
+#include <vector>
+#include <limits>
+#include <utility>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+// QuantileSketch is a KLL sketch (Karnin, Lang and Liberty, "Optimal Quantile Approximation in Streams")
+// answering approximate quantile and rank queries over a stream of values in bounded memory.
+// Values are kept in levels, where each value on level h stands for 2^h of the values added. When the
+// sketch is full, the lowest level at its capacity is sorted and every other value (starting at a random
+// offset) is promoted one level up, the rest dropped. Level capacities shrink by a factor of 2/3 going
+// down from the top level, so the sketch holds at most about 3k values whatever the length of the stream,
+// and the rank error is roughly 1.7 / k of the number of values added (about 1% for the default k = 200).
+// Sketches with the same k can be merged, so per-thread sketches combine into one for the whole input.
+// The smallest and largest values are tracked exactly, so the 0 and 1 quantiles are exact.
+template <typename T = double>
+class QuantileSketch
+{
+ public:
+  explicit QuantileSketch(int k = 200) : m_k(k)
+  {
+    if ( k < 8 ) throw std::invalid_argument("QuantileSketch k must be at least 8");
+  }
+
+  // Adds value weight times. Integer weights are added as one value per set bit, on the level of that bit,
+  // so a heavy weight costs O(log weight) rather than O(weight).
+  void add(T value, std::uint64_t weight = 1) {
+    if ( weight == 0 ) return;
+    if ( m_count == 0 ) { m_min = value; m_max = value; }
+    else { m_min = std::min(m_min, value); m_max = std::max(m_max, value); }
+    m_count += weight;
+    for ( int level = 0; weight != 0; level++, weight >>= 1 ) {
+      if ( weight & 1 ) {
+	growTo(level + 1);
+	m_levels[level].push_back(value);
+	m_size++;
+      }
+    }
+    while ( m_size >= m_capacity ) compress();
+  }
+
+  // Adds every value of other into this sketch. Both sketches must have the same k.
+  void merge(const QuantileSketch& other) {
+    if ( m_k != other.m_k ) throw std::invalid_argument("QuantileSketch merge requires sketches with the same k");
+    if ( other.m_count == 0 ) return;
+    if ( m_count == 0 ) { m_min = other.m_min; m_max = other.m_max; }
+    else { m_min = std::min(m_min, other.m_min); m_max = std::max(m_max, other.m_max); }
+    m_count += other.m_count;
+    growTo(other.m_levels.size());
+    for ( std::size_t h = 0; h < other.m_levels.size(); h++ ) {
+      m_levels[h].insert(m_levels[h].end(), other.m_levels[h].begin(), other.m_levels[h].end());
+      m_size += other.m_levels[h].size();
+    }
+    while ( m_size >= m_capacity ) compress();
+  }
+
+  QuantileSketch& operator+=(const QuantileSketch& other) {
+    merge(other);
+    return *this;
+  }
+
+  void clear() {
+    m_levels.clear();
+    m_size = 0;
+    m_capacity = 0;
+    m_count = 0;
+  }
+
+  bool empty() const { return m_count == 0; }
+  // Number of values added, counting weights
+  std::uint64_t count() const { return m_count; }
+  int getK() const { return m_k; }
+  // Number of values currently retained
+  std::size_t retained() const { return m_size; }
+  T min() const { return m_min; }
+  T max() const { return m_max; }
+
+  // Approximate q quantile (0 <= q <= 1): the smallest retained value whose estimated rank covers q of the count.
+  // Returns NaN (or 0 for integer T) if nothing has been added.
+  T quantile(double q) const {
+    if ( m_count == 0 ) return std::numeric_limits<T>::quiet_NaN();
+    if ( q <= 0 ) return m_min;
+    if ( q >= 1 ) return m_max;
+    std::vector<std::pair<T, std::uint64_t>> items = weightedItems();
+    double target = q * m_count;
+    std::uint64_t cumulative = 0;
+    for ( const auto& item: items ) {
+      cumulative += item.second;
+      if ( cumulative >= target ) return item.first;
+    }
+    return m_max;
+  }
+
+  // Several quantiles from one pass over the sorted retained values; qs must be in increasing order
+  std::vector<T> quantiles(const std::vector<double>& qs) const {
+    std::vector<T> result(qs.size(), std::numeric_limits<T>::quiet_NaN());
+    if ( m_count == 0 ) return result;
+    std::vector<std::pair<T, std::uint64_t>> items = weightedItems();
+    std::uint64_t cumulative = 0;
+    std::size_t i = 0;
+    for ( std::size_t q = 0; q < qs.size(); q++ ) {
+      if ( qs[q] <= 0 ) { result[q] = m_min; continue; }
+      double target = qs[q] * m_count;
+      while ( i < items.size() && cumulative + items[i].second < target ) cumulative += items[i++].second;
+      result[q] = i < items.size() && qs[q] < 1 ? items[i].first : m_max;
+    }
+    return result;
+  }
+
+  // Approximate fraction of the values added that are <= value
+  double rank(T value) const {
+    if ( m_count == 0 ) return 0;
+    std::uint64_t below = 0;
+    for ( std::size_t h = 0; h < m_levels.size(); h++ ) {
+      for ( T item: m_levels[h] ) {
+	if ( item <= value ) below += std::uint64_t(1) << h;
+      }
+    }
+    return (double) below / m_count;
+  }
+
+ private:
+  int m_k;
+  std::vector<std::vector<T>> m_levels;   // m_levels[h] holds values of weight 2^h
+  std::size_t m_size = 0;                 // values retained over all levels
+  std::size_t m_capacity = 0;             // sum of the level capacities
+  std::uint64_t m_count = 0;
+  T m_min = T();
+  T m_max = T();
+  std::uint64_t m_random = 0x9e3779b97f4a7c15ULL;   // state of the coin flipped at each compaction
+
+  // Capacity of level h: k on the top level, shrinking by 2/3 per level below it, but never under 2
+  std::size_t levelCapacity(std::size_t h) const {
+    double capacity = m_k;
+    for ( std::size_t depth = m_levels.size() - 1 - h; depth > 0 && capacity >= 2; depth-- ) capacity *= 2.0 / 3.0;
+    return std::max<std::size_t>(2, (std::size_t) capacity);
+  }
+
+  void growTo(std::size_t levels) {
+    if ( m_levels.size() >= levels ) return;
+    m_levels.resize(levels);
+    m_capacity = 0;
+    for ( std::size_t h = 0; h < m_levels.size(); h++ ) m_capacity += levelCapacity(h);
+  }
+
+  bool coin() {
+    // xorshift64
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 7;
+    m_random ^= m_random << 17;
+    return m_random & 1;
+  }
+
+  // Compacts the lowest level that has reached its capacity, halving it into the level above.
+  // Called only when the sketch holds at least its total capacity, so some level is always at capacity.
+  void compress() {
+    for ( std::size_t h = 0; h < m_levels.size(); h++ ) {
+      if ( m_levels[h].size() < levelCapacity(h) ) continue;
+      if ( h + 1 == m_levels.size() ) growTo(h + 2);
+      std::vector<T>& level = m_levels[h];
+      std::vector<T>& above = m_levels[h + 1];
+      std::sort(level.begin(), level.end());
+      // An odd value out stays behind, so the weight of the sketch is preserved exactly
+      std::size_t keep = level.size() % 2;
+      std::size_t offset = keep + coin();
+      std::size_t before = level.size();
+      for ( std::size_t i = offset; i < before; i += 2 ) above.push_back(level[i]);
+      level.resize(keep);
+      m_size -= before - keep - (before - keep) / 2;
+      return;
+    }
+  }
+
+  std::vector<std::pair<T, std::uint64_t>> weightedItems() const {
+    std::vector<std::pair<T, std::uint64_t>> items;
+    items.reserve(m_size);
+    for ( std::size_t h = 0; h < m_levels.size(); h++ ) {
+      for ( T item: m_levels[h] ) items.push_back(std::make_pair(item, std::uint64_t(1) << h));
+    }
+    std::sort(items.begin(), items.end());
+    return items;
+  }
+};
+
+#endif // QUANTILE_SKETCH
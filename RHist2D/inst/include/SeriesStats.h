@@ -0,0 +1,116 @@
+#ifndef SERIES_STATS
+#define SERIES_STATS
+
+#include <algorithm>
+#include <type_traits>
+
+// Running mean and variance of a series, updated one value at a time.
+// Floating point series use Welford's update. Integer series of up to 32 bits accumulate exact integer sums
+// instead, so their mean and variance are correctly rounded and match the two-pass computation they replace.
+// Wider integers (e.g. long long timestamps) could overflow those sums and use Welford's update too.
+template <typename T, bool exact = std::is_integral<T>::value && sizeof(T) <= 4>
+struct SeriesMoments
+{
+  double mean = 0.0;
+  double m2 = 0.0;
+  long long count = 0;
+
+  void add(T v) {
+    count++;
+    double delta = v - mean;
+    mean += delta / count;
+    m2   += delta * (v - mean);
+  }
+  double getMean() const { return mean; }
+  double getVariance() const { return m2 / count; }
+};
+
+#if defined(__SIZEOF_INT128__)
+template <typename T>
+struct SeriesMoments<T, true>
+{
+  // A series has fewer than 2^31 values, so the sum fits 63 bits and the square sum 95 bits for these types
+  static_assert(sizeof(T) <= 4, "exact moments need an integer type of at most 32 bits");
+
+  long long sum = 0;
+  __int128 squareSum = 0;
+  long long count = 0;
+
+  void add(T v) {
+    count++;
+    sum += v;
+    squareSum += (__int128) v * v;
+  }
+  double getMean() const { return (double) sum / count; }
+  // n * sum(v^2) - (sum v)^2 is exact in 128 bits, leaving a single rounding in the final division
+  double getVariance() const {
+    __int128 scaled = squareSum * count - (__int128) sum * sum;
+    return (double) scaled / ((double) count * count);
+  }
+};
+#endif
+
+// Fused summary statistics for a single series held as two arrays of n paired y and x values.
+// Everything getAllData reports except the unique count is gathered in one traversal with no
+// heap allocation, writing the same layout:
+// 0. length of series, 1. min yAxis value, 2. max yAxis value, 3. min xAxis value,
+// 4. max xAxis value, 5. inflection count, 7. mean of series, 8. variance of series
+// Slot 6 (number of unique levels) is left for the caller, see countUniqueSmall below.
+// An empty series reports -999 for mean and variance, as NumericVector does.
+template <typename T>
+void computeSeriesStats(const T* y, const T* x, int n, double* result)
+{
+  result[0] = n;
+  if ( n == 0 ) {
+    result[1] = result[2] = result[3] = result[4] = result[5] = 0;
+    result[7] = result[8] = -999.0;
+    return;
+  }
+  T minY = y[0], maxY = y[0], minX = x[0], maxX = x[0];
+  SeriesMoments<T> moments;
+  int inflections = 0;
+  // Inflections follow NumericVector's original definition, whose first "difference" is the
+  // second value itself, so a series starting y0, y1, y2 compares the sign of y1 against that of y2 - y1
+  bool previous = n > 1 && y[1] < 0;
+  for ( int i = 0; i < n; i++ ) {
+    T v = y[i];
+    minY = std::min(minY, v);
+    maxY = std::max(maxY, v);
+    minX = std::min(minX, x[i]);
+    maxX = std::max(maxX, x[i]);
+    moments.add(v);
+    if ( i >= 2 ) {
+      bool current = (v - y[i-1]) < 0;
+      inflections += (current != previous);
+      previous = current;
+    }
+  }
+  result[1] = minY;
+  result[2] = maxY;
+  result[3] = minX;
+  result[4] = maxX;
+  result[5] = inflections;
+  result[7] = moments.getMean();
+  result[8] = moments.getVariance();
+}
+
+// Series at most this long have their unique values counted by direct comparison
+const int SMALL_SERIES_LENGTH = 32;
+
+// Number of distinct values in y[0..n) for n <= SMALL_SERIES_LENGTH, by checking each value against
+// the ones before it. No allocation, and faster than sorting a copy for the short series typical of scrape data.
+template <typename T>
+int countUniqueSmall(const T* y, int n)
+{
+  int unique = 0;
+  for ( int i = 0; i < n; i++ ) {
+    bool seen = false;
+    for ( int j = 0; j < i; j++ ) {
+      seen |= (y[j] == y[i]);
+    }
+    unique += !seen;
+  }
+  return unique;
+}
+
+#endif // SERIES_STATS
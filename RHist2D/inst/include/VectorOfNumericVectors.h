@@ -0,0 +1,110 @@
+#ifndef VECTOR_NUMERIC_VECTORS
+#define VECTOR_NUMERIC_VECTORS
+
+#include <limits>
+
+#include "NumericVector.h"
+
+/*
+This class holds a vector of NumericVectors so that summary statistics can be computed across a set of series
+rather than across an individual series. The max and min values of the x and y values of all series
+taken together are tracked. Also the class computes and returns a concatenated single vector putting together
+the entire series for cases when the user wants to perform additional custom summary statitics on the set as a whole
+in a convenient container. 
+Once Concatenate() has run, further series added with AddToVector are appended to the
+concatenated vector in place, so building a set incrementally stays linear in its total size.
+ */
+
+template <typename T,
+typename = typename std::enable_if<std::is_arithmetic<T>::value, T>::type>
+class VectorOfNumericVectors
+{
+ public:
+ VectorOfNumericVectors()
+   : m_wasConcatenated(false), m_statsCurrent(false),
+   m_maxLength(0), m_minLength(std::numeric_limits<int>::max()),
+   m_maxY(std::numeric_limits<T>::lowest()), m_minY(std::numeric_limits<T>::max()),
+   m_maxX(std::numeric_limits<T>::lowest()), m_minX(std::numeric_limits<T>::max())
+    {}
+ VectorOfNumericVectors(const std::vector<NumericVector<T>>& vec)
+   : VectorOfNumericVectors()
+    {
+      m_vec = vec;
+    }
+
+  //each time a NumericVector is added to the VectorOfNumericVectors update aggregate measurements
+  void AddToVector(const NumericVector<T>& list){
+    m_vec.push_back(list);
+    m_maxLength = std::max(m_maxLength, list.length);
+    m_minLength = std::min(m_minLength, list.length);
+    m_maxY = std::max(m_maxY, list.m_maxY);
+    m_minY = std::min(m_minY, list.m_minY);
+    m_maxX = std::max(m_maxX, list.m_maxX);
+    m_minX = std::min(m_minX, list.m_minX);
+
+    // Extends the existing concatenation in place rather than rebuilding it
+    if ( m_wasConcatenated ) {
+      m_concatenatedVector.append(list);
+    }
+  }
+ 
+  //concatenate values of all NumericVectors
+  void Concatenate(){
+    if ( !m_wasConcatenated ) {
+      std::vector<T> toConcatY, toConcatX;
+      for ( auto it = m_vec.begin(); it != m_vec.end(); it++ ) {
+	const std::vector<T>& yHolder = (*it).getYConst();
+	const std::vector<T>& xHolder = (*it).getXConst();
+	toConcatY.insert(toConcatY.end(), yHolder.begin(), yHolder.end());
+	toConcatX.insert(toConcatX.end(), xHolder.begin(), xHolder.end());
+	if ( !m_statsCurrent ) {
+	  int new_length = yHolder.size();
+	  m_maxLength = std::max(m_maxLength, new_length);
+	  m_minLength = std::min(m_minLength, new_length);
+	}
+      }
+      if ( !toConcatY.empty() ) {
+	m_concatenatedVector = NumericVector<T>(toConcatY, toConcatX);
+      }
+      m_wasConcatenated = true;
+    } 
+  }
+
+  const NumericVector<T>& getConcatenated() {
+    if ( !m_wasConcatenated ) Concatenate(); 
+    return m_concatenatedVector;
+  }
+  const std::vector<double> getSummaryVals() {
+    if ( !m_statsCurrent ) {
+      Concatenate();
+      m_maxY = m_concatenatedVector.m_maxY;
+      m_minY = m_concatenatedVector.m_minY;
+      m_maxX   = m_concatenatedVector.m_maxX;
+      m_minX   = m_concatenatedVector.m_minX;
+    }
+    return std::vector<double> {(double) m_maxLength, (double) m_minLength, (double) m_maxY, (double) m_minY, (double) m_maxX, (double) m_minX};
+  }
+  
+  // Retrieves constant reference to the series held in the container
+  const std::vector<NumericVector<T>>& getVector() const { return m_vec; }
+
+  void print(std::ostream& os) const {
+    for ( auto it = m_vec.begin(); it != m_vec.end(); it++ ) {
+      (*it).print(os);
+    }
+  }
+  
+ private:
+  std::vector<NumericVector<T>> m_vec;
+  NumericVector<T> m_concatenatedVector;
+  bool m_wasConcatenated; 
+  bool m_statsCurrent;
+  int  m_maxLength;
+  int  m_minLength;
+  T    m_maxY;
+  T    m_minY;
+  T    m_maxX;
+  T    m_minX; 
+};
+
+#endif // VECTOR_NUMERIC_VECTORS
@@ -0,0 +1,96 @@
+// Generated by using Rcpp::compileAttributes() -> do not edit by hand
+// Generator token: 10BE3573-1514-4C36-9D1C-5A225CD40393
+
+#include <Rcpp.h>
+
+using namespace Rcpp;
+
+// hist2d_cpp
+Rcpp::NumericMatrix hist2d_cpp(Rcpp::List y, Rcpp::List x, std::vector<double> xEdges, std::vector<double> yEdges, std::string alignment);
+RcppExport SEXP _RHist2D_hist2d_cpp(SEXP ySEXP, SEXP xSEXP, SEXP xEdgesSEXP, SEXP yEdgesSEXP, SEXP alignmentSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type x(xSEXP);
+    Rcpp::traits::input_parameter< std::vector<double> >::type xEdges(xEdgesSEXP);
+    Rcpp::traits::input_parameter< std::vector<double> >::type yEdges(yEdgesSEXP);
+    Rcpp::traits::input_parameter< std::string >::type alignment(alignmentSEXP);
+    rcpp_result_gen = Rcpp::wrap(hist2d_cpp(y, x, xEdges, yEdges, alignment));
+    return rcpp_result_gen;
+END_RCPP
+}
+// hist2d_new_cpp
+SEXP hist2d_new_cpp(std::vector<double> xEdges, std::vector<double> yEdges);
+RcppExport SEXP _RHist2D_hist2d_new_cpp(SEXP xEdgesSEXP, SEXP yEdgesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::vector<double> >::type xEdges(xEdgesSEXP);
+    Rcpp::traits::input_parameter< std::vector<double> >::type yEdges(yEdgesSEXP);
+    rcpp_result_gen = Rcpp::wrap(hist2d_new_cpp(xEdges, yEdges));
+    return rcpp_result_gen;
+END_RCPP
+}
+// hist2d_add_cpp
+void hist2d_add_cpp(SEXP hist, Rcpp::List y, Rcpp::List x, std::string alignment);
+RcppExport SEXP _RHist2D_hist2d_add_cpp(SEXP histSEXP, SEXP ySEXP, SEXP xSEXP, SEXP alignmentSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type hist(histSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type x(xSEXP);
+    Rcpp::traits::input_parameter< std::string >::type alignment(alignmentSEXP);
+    hist2d_add_cpp(hist, y, x, alignment);
+    return R_NilValue;
+END_RCPP
+}
+// hist2d_counts_cpp
+Rcpp::NumericMatrix hist2d_counts_cpp(SEXP hist);
+RcppExport SEXP _RHist2D_hist2d_counts_cpp(SEXP histSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type hist(histSEXP);
+    rcpp_result_gen = Rcpp::wrap(hist2d_counts_cpp(hist));
+    return rcpp_result_gen;
+END_RCPP
+}
+// hist2d_merge_cpp
+void hist2d_merge_cpp(SEXP into, SEXP from);
+RcppExport SEXP _RHist2D_hist2d_merge_cpp(SEXP intoSEXP, SEXP fromSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type into(intoSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type from(fromSEXP);
+    hist2d_merge_cpp(into, from);
+    return R_NilValue;
+END_RCPP
+}
+// series_traits_cpp
+Rcpp::DataFrame series_traits_cpp(Rcpp::List y, Rcpp::List x);
+RcppExport SEXP _RHist2D_series_traits_cpp(SEXP ySEXP, SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(series_traits_cpp(y, x));
+    return rcpp_result_gen;
+END_RCPP
+}
+
+static const R_CallMethodDef CallEntries[] = {
+    {"_RHist2D_hist2d_cpp", (DL_FUNC) &_RHist2D_hist2d_cpp, 5},
+    {"_RHist2D_hist2d_new_cpp", (DL_FUNC) &_RHist2D_hist2d_new_cpp, 2},
+    {"_RHist2D_hist2d_add_cpp", (DL_FUNC) &_RHist2D_hist2d_add_cpp, 4},
+    {"_RHist2D_hist2d_counts_cpp", (DL_FUNC) &_RHist2D_hist2d_counts_cpp, 1},
+    {"_RHist2D_hist2d_merge_cpp", (DL_FUNC) &_RHist2D_hist2d_merge_cpp, 2},
+    {"_RHist2D_series_traits_cpp", (DL_FUNC) &_RHist2D_series_traits_cpp, 2},
+    {NULL, NULL, 0}
+};
+
+RcppExport void R_init_RHist2D(DllInfo *dll) {
+    R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
+    R_useDynamicSymbols(dll, FALSE);
+}
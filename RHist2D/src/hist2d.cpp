@@ -0,0 +1,162 @@
+#include <Rcpp.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "Hist2D.h"
+
+// R binding for Hist2D and the per-series traits of NumericVector.
+// Series arrive as lists of numeric vectors (e.g. data.frame list-columns of ranks and timestamps).
+// Double vectors are binned straight from R's memory through NumericSeriesViews; integer vectors are
+// converted into a reused scratch buffer. Counts are kept as doubles, but the matrix returned to R is a
+// copy: Hist2D stores them row-major with a ring of guard bins, while R wants a column-major matrix of
+// the in-range bins only, so they are transposed into a new NumericMatrix on each call.
+
+typedef Hist2D<double> RHist;
+
+namespace {
+
+Hist2DAlignment::Alignment parseAlignment(const std::string& name) {
+  typedef Hist2DAlignment::Alignment Alignment;
+  if ( name == "front" ) return Alignment::Front;
+  if ( name == "back" )  return Alignment::Back;
+  if ( name == "atmax" ) return Alignment::AtMax;
+  if ( name == "atmin" ) return Alignment::AtMin;
+  if ( name == "byx" )   return Alignment::ByX;
+  Rcpp::stop("unknown alignment '" + name + "', expected front, back, atmax, atmin or byx");
+}
+
+// Reads series i of a pair of list-columns as a NumericSeriesView
+class SeriesLists
+{
+ public:
+  SeriesLists(const Rcpp::List& y, const Rcpp::List& x) : m_y(y), m_x(x) {
+    if ( y.size() != x.size() ) Rcpp::stop("y and x must hold the same number of series");
+  }
+
+  R_xlen_t size() const { return m_y.size(); }
+
+  NumericSeriesView<double> operator[](R_xlen_t i) {
+    SEXP y = m_y[i];
+    SEXP x = m_x[i];
+    R_xlen_t n = Rf_xlength(y);
+    if ( Rf_xlength(x) != n ) Rcpp::stop("series " + std::to_string(i + 1) + " has different numbers of y and x values");
+    if ( n == 0 ) return NumericSeriesView<double>();
+    const double* yValues = values(y, m_yScratch);
+    const double* xValues = values(x, m_xScratch);
+    auto yRange = std::minmax_element(yValues, yValues + n);
+    auto xRange = std::minmax_element(xValues, xValues + n);
+    return NumericSeriesView<double>(yValues, xValues, n, *yRange.second, *yRange.first, *xRange.second, *xRange.first);
+  }
+
+ private:
+  Rcpp::List m_y;
+  Rcpp::List m_x;
+  std::vector<double> m_yScratch;
+  std::vector<double> m_xScratch;
+
+  static const double* values(SEXP series, std::vector<double>& scratch) {
+    switch ( TYPEOF(series) ) {
+    case REALSXP:
+      return REAL(series);
+    case INTSXP: {
+      const int* ints = INTEGER(series);
+      scratch.assign(ints, ints + Rf_xlength(series));
+      return scratch.data();
+    }
+    default:
+      Rcpp::stop("series must be numeric or integer vectors");
+    }
+  }
+};
+
+void addLists(RHist& hist, const Rcpp::List& y, const Rcpp::List& x, const std::string& alignment) {
+  Hist2DAlignment::Alignment align = parseAlignment(alignment);
+  SeriesLists series(y, x);
+  for ( R_xlen_t i = 0; i < series.size(); i++ ) {
+    NumericSeriesView<double> view = series[i];
+    if ( view.length > 0 ) hist.addToHist(view, align);
+  }
+}
+
+// Copies the in-range counts into a new ybins x xbins R matrix, row 1 being the lowest y bin as in the text files
+Rcpp::NumericMatrix countMatrix(const RHist& hist) {
+  int xBins = hist.getXBins();
+  int yBins = hist.getYBins();
+  Rcpp::NumericMatrix counts(Rcpp::no_init(yBins, xBins));
+  double* out = counts.begin();
+  for ( int x = 0; x < xBins; x++ ) {
+    for ( int y = 0; y < yBins; y++ ) {
+      *out++ = hist.getCount(y, x);
+    }
+  }
+  return counts;
+}
+
+Rcpp::XPtr<RHist> histPointer(SEXP hist) {
+  Rcpp::XPtr<RHist> pointer(hist);
+  if ( pointer.get() == nullptr ) Rcpp::stop("histogram is no longer valid (was it saved and reloaded?)");
+  return pointer;
+}
+
+} // namespace
+
+// [[Rcpp::export]]
+Rcpp::NumericMatrix hist2d_cpp(Rcpp::List y, Rcpp::List x, std::vector<double> xEdges, std::vector<double> yEdges, std::string alignment) {
+  RHist hist(xEdges, yEdges);
+  addLists(hist, y, x, alignment);
+  return countMatrix(hist);
+}
+
+// [[Rcpp::export]]
+SEXP hist2d_new_cpp(std::vector<double> xEdges, std::vector<double> yEdges) {
+  return Rcpp::XPtr<RHist>(new RHist(xEdges, yEdges), true);
+}
+
+// [[Rcpp::export]]
+void hist2d_add_cpp(SEXP hist, Rcpp::List y, Rcpp::List x, std::string alignment) {
+  addLists(*histPointer(hist), y, x, alignment);
+}
+
+// [[Rcpp::export]]
+Rcpp::NumericMatrix hist2d_counts_cpp(SEXP hist) {
+  return countMatrix(*histPointer(hist));
+}
+
+// [[Rcpp::export]]
+void hist2d_merge_cpp(SEXP into, SEXP from) {
+  histPointer(into)->merge(*histPointer(from));
+}
+
+// [[Rcpp::export]]
+Rcpp::DataFrame series_traits_cpp(Rcpp::List y, Rcpp::List x) {
+  SeriesLists series(y, x);
+  R_xlen_t n = series.size();
+  const char* names[9] = {"length", "min_y", "max_y", "min_x", "max_x", "inflections", "unique_levels", "mean", "sd"};
+  std::vector<Rcpp::NumericVector> columns;
+  for ( int c = 0; c < 9; c++ ) columns.push_back(Rcpp::NumericVector(Rcpp::no_init(n)));
+
+  double row[9];
+  for ( R_xlen_t i = 0; i < n; i++ ) {
+    NumericSeriesView<double> view = series[i];
+    if ( view.length > 0 ) {
+      computeSeriesStats(view.getYData(), view.getXData(), view.length, row);
+      row[6] = view.getUniqueCount();
+    } else {
+      std::fill(row, row + 9, NA_REAL);
+    }
+    for ( int c = 0; c < 9; c++ ) columns[c][i] = row[c];
+  }
+
+  Rcpp::List result(9);
+  Rcpp::CharacterVector columnNames(9);
+  for ( int c = 0; c < 9; c++ ) {
+    result[c] = columns[c];
+    columnNames[c] = names[c];
+  }
+  result.attr("names") = columnNames;
+  result.attr("class") = "data.frame";
+  result.attr("row.names") = Rcpp::IntegerVector::create(NA_INTEGER, -(int) n);
+  return Rcpp::DataFrame(result);
+}